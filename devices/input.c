@@ -1,15 +1,34 @@
 #include "devices/input.h"
 #include <debug.h>
+#include <poll.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/pollq.h"
+#include "threads/thread.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Waiters for keys to arrive. */
+static struct poll_queue waiters;
+
+/* A thread blocked in input_read(), on its own stack.  Whoever
+   unblocks it first removes it from READERS. */
+struct input_reader {
+	struct thread *thread;
+	struct list_elem elem;              /* In READERS. */
+};
+
+/* Threads blocked in input_read(), protected by turning
+   interrupts off. */
+static struct list readers;
+
 /* Initializes the input buffer. */
 void
 input_init (void) {
 	intq_init (&buffer);
+	poll_queue_init (&waiters);
+	list_init (&readers);
 }
 
 /* Adds a key to the input buffer.
@@ -21,6 +40,10 @@ input_putc (uint8_t key) {
 
 	intq_putc (&buffer, key);
 	serial_notify ();
+	poll_queue_wake (&waiters, POLLIN);
+	while (!list_empty (&readers))
+		thread_unblock (list_entry (list_pop_front (&readers),
+					struct input_reader, elem)->thread);
 }
 
 /* Retrieves a key from the input buffer.
@@ -38,6 +61,70 @@ input_getc (void) {
 	return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into BUF and
+   returns the number retrieved.  Waits for a key to be pressed
+   only if the buffer is empty to begin with, and then only for
+   the first.  Returns 0 without waiting further once the calling
+   thread's process starts exiting; see input_cancel(). */
+size_t
+input_read (uint8_t *buf, size_t size) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	while (intq_empty (&buffer) && !curr->proc->exiting) {
+		struct input_reader r;
+
+		r.thread = curr;
+		list_push_back (&readers, &r.elem);
+		thread_block ();
+	}
+	for (cnt = 0; cnt < size && !intq_empty (&buffer); cnt++)
+		buf[cnt] = intq_getc (&buffer);
+	serial_notify ();
+	intr_set_level (old_level);
+
+	return cnt;
+}
+
+/* Wakes the threads of PROC blocked in input_read(), so that they
+   notice PROC is exiting. */
+void
+input_cancel (struct thread *proc) {
+	enum intr_level old_level;
+	struct list_elem *e;
+
+	old_level = intr_disable ();
+	for (e = list_begin (&readers); e != list_end (&readers); ) {
+		struct input_reader *r = list_entry (e, struct input_reader, elem);
+
+		if (r->thread->proc == proc) {
+			e = list_remove (e);
+			thread_unblock (r->thread);
+		} else
+			e = list_next (e);
+	}
+	intr_set_level (old_level);
+}
+
+/* Returns POLLIN if a key is waiting in the input buffer, and 0
+   otherwise.  If W is not null, it is also added to the queue of
+   waiters told when a key arrives. */
+unsigned
+input_poll (struct poll_waiter *w) {
+	enum intr_level old_level;
+	unsigned events;
+
+	old_level = intr_disable ();
+	if (w != NULL)
+		poll_queue_add (&waiters, w);
+	events = intq_empty (&buffer) ? 0 : POLLIN;
+	intr_set_level (old_level);
+
+	return events;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
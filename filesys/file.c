@@ -2,30 +2,94 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	int ref_cnt;                /* References; see file_share(). */
+	struct pipe *pipe;          /* Pipe, if this is one end of it. */
+	bool writer;                /* Writing end of PIPE? */
+	bool watcher;               /* Only watching PIPE, as no end? */
+	struct epoll *epoll;        /* Interest set, if this is one. */
 };
 
+/* Cache of open files. */
+static struct kmem_cache file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void) {
+	kmem_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) {
-	struct file *file = calloc (1, sizeof *file);
+	struct file *file = kmem_cache_alloc (&file_cache);
 	if (inode != NULL && file != NULL) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
+		file->pipe = NULL;
+		file->writer = false;
+		file->watcher = false;
+		file->epoll = NULL;
 		return file;
 	} else {
 		inode_close (inode);
-		free (file);
+		kmem_cache_free (&file_cache, file);
+		return NULL;
+	}
+}
+
+/* Opens and returns a file for the writing end of pipe PIPE if
+ * WRITER is true, or for its reading end otherwise, taking over
+ * the caller's reference to that end.  Returns a null pointer,
+ * after closing the end, if an allocation fails. */
+struct file *
+file_open_pipe (struct pipe *pipe, bool writer) {
+	struct file *file = kmem_cache_alloc (&file_cache);
+	if (file == NULL) {
+		pipe_close_end (pipe, writer);
+		return NULL;
+	}
+	file->inode = NULL;
+	file->pos = 0;
+	file->deny_write = false;
+	file->ref_cnt = 1;
+	file->pipe = pipe;
+	file->writer = writer;
+	file->watcher = false;
+	file->epoll = NULL;
+	return file;
+}
+
+/* Opens and returns a file for interest set EP, taking over the
+ * caller's reference to it.  Returns a null pointer, after
+ * dropping the reference, if an allocation fails. */
+struct file *
+file_open_epoll (struct epoll *ep) {
+	struct file *file = kmem_cache_alloc (&file_cache);
+	if (file == NULL) {
+		epoll_close (ep);
 		return NULL;
 	}
+	file->inode = NULL;
+	file->pos = 0;
+	file->deny_write = false;
+	file->ref_cnt = 1;
+	file->pipe = NULL;
+	file->writer = false;
+	file->watcher = false;
+	file->epoll = ep;
+	return file;
 }
 
 /* Opens and returns a new file for the same inode as FILE.
@@ -39,7 +103,18 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
-	struct file *nfile = file_open (inode_reopen (file->inode));
+	struct file *nfile;
+	if (file->watcher)
+		return file_watch (file);
+	if (file->pipe != NULL) {
+		pipe_open_end (file->pipe, file->writer);
+		return file_open_pipe (file->pipe, file->writer);
+	}
+	if (file->epoll != NULL) {
+		epoll_open (file->epoll);
+		return file_open_epoll (file->epoll);
+	}
+	nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
 		if (file->deny_write)
@@ -48,17 +123,95 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Returns a new file for polling FILE, which an interest set may
+ * hold on to.  For a pipe it watches the same end without counting
+ * as one, so closing every real end still gives end of file or a
+ * broken pipe.  Other files are duplicated.  Returns a null
+ * pointer if unsuccessful. */
+struct file *
+file_watch (struct file *file) {
+	struct file *nfile;
+	if (file->pipe == NULL)
+		return file_duplicate (file);
+	nfile = kmem_cache_alloc (&file_cache);
+	if (nfile == NULL)
+		return NULL;
+	pipe_watch (file->pipe);
+	nfile->inode = NULL;
+	nfile->pos = 0;
+	nfile->deny_write = false;
+	nfile->ref_cnt = 1;
+	nfile->pipe = file->pipe;
+	nfile->writer = file->writer;
+	nfile->watcher = true;
+	nfile->epoll = NULL;
+	return nfile;
+}
+
+/* Returns FILE with one more reference to it, for another file
+ * descriptor that shares its position.  Each reference is dropped
+ * by a call to file_close().  The count is atomic, since
+ * fd_get() takes a reference without any lock. */
+struct file *
+file_share (struct file *file) {
+	__atomic_fetch_add (&file->ref_cnt, 1, __ATOMIC_SEQ_CST);
+	return file;
+}
+
+/* Returns true if FILE has more than one reference. */
+bool
+file_shared (struct file *file) {
+	return __atomic_load_n (&file->ref_cnt, __ATOMIC_SEQ_CST) > 1;
+}
+
+/* Drops a reference to FILE, closing it when the last one goes. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	if (file != NULL
+			&& __atomic_sub_fetch (&file->ref_cnt, 1, __ATOMIC_SEQ_CST) == 0) {
+		if (file->watcher)
+			pipe_unwatch (file->pipe);
+		else if (file->pipe != NULL)
+			pipe_close_end (file->pipe, file->writer);
+		if (file->epoll != NULL)
+			epoll_close (file->epoll);
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		kmem_cache_free (&file_cache, file);
 	}
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Returns the pipe that FILE is one end of, and sets *WRITER to
+ * whether it is the writing end, or returns a null pointer if FILE
+ * is not a pipe. */
+struct pipe *
+file_get_pipe (struct file *file, bool *writer) {
+	*writer = file->writer;
+	return file->pipe;
+}
+
+/* Returns the interest set that FILE is open on, or a null
+ * pointer if FILE is not one. */
+struct epoll *
+file_get_epoll (struct file *file) {
+	return file->epoll;
+}
+
+/* Returns the poll() events ready on FILE.  If W is not null, it
+ * is also added to the queue of waiters told when they change.
+ * Files in the file system are always ready to read and write, so
+ * W is left on no queue for them. */
+unsigned
+file_poll (struct file *file, struct poll_waiter *w) {
+	if (file->pipe != NULL)
+		return pipe_poll (file->pipe, file->writer, w);
+	if (file->epoll != NULL)
+		return epoll_poll (file->epoll, w);
+	return POLLIN | POLLOUT;
+}
+
+/* Returns the inode encapsulated by FILE, or a null pointer if it
+ * is a pipe or an interest set. */
 struct inode *
 file_get_inode (struct file *file) {
 	return file->inode;
@@ -136,10 +289,13 @@ file_allow_write (struct file *file) {
 	}
 }
 
-/* Returns the size of FILE in bytes. */
+/* Returns the size of FILE in bytes, which is 0 for a pipe or an
+ * interest set. */
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->pipe != NULL || file->epoll != NULL)
+		return 0;
 	return inode_length (file->inode);
 }
 
@@ -2,11 +2,18 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct poll_waiter;
+struct thread;
+
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+size_t input_read (uint8_t *, size_t);
+void input_cancel (struct thread *proc);
+unsigned input_poll (struct poll_waiter *);
 bool input_full (void);
 
 #endif /* devices/input.h */
@@ -1,16 +1,32 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct pipe;
+struct epoll;
+struct poll_waiter;
+
+void file_init (void);
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
+struct file *file_open_pipe (struct pipe *, bool writer);
+struct file *file_open_epoll (struct epoll *);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_watch (struct file *);
+struct file *file_share (struct file *);
+bool file_shared (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
+struct pipe *file_get_pipe (struct file *, bool *writer);
+struct epoll *file_get_epoll (struct file *);
+
+/* Readiness. */
+unsigned file_poll (struct file *, struct poll_waiter *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
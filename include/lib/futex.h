@@ -0,0 +1,18 @@
+#ifndef __LIB_FUTEX_H
+#define __LIB_FUTEX_H
+
+/* Operations of the futex system call, shared by the kernel and
+   user programs.  A futex is a 32-bit word of user memory that
+   threads may sleep on until another thread changes the word and
+   wakes them. */
+enum futex_op {
+	FUTEX_WAIT,                 /* Sleep if the word holds VAL. */
+	FUTEX_WAKE,                 /* Wake up to VAL sleepers. */
+};
+
+/* Results of FUTEX_WAIT. */
+#define FUTEX_WOKEN 0               /* Woken, perhaps spuriously. */
+#define FUTEX_MISMATCH 1            /* The word did not hold VAL. */
+#define FUTEX_TIMEDOUT 2            /* The timeout passed first. */
+
+#endif /* lib/futex.h */
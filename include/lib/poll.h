@@ -0,0 +1,46 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+#include <stdint.h>
+
+/* Readiness events of poll() and the epoll calls, shared by the
+   kernel and user programs. */
+#define POLLIN 0x001                /* Reading would not block. */
+#define POLLOUT 0x004               /* Writing would not block. */
+#define POLLERR 0x008               /* Writes fail; no reader is left. */
+#define POLLHUP 0x010               /* No writer is left. */
+#define POLLNVAL 0x020              /* Descriptor is not open. */
+
+/* A descriptor for poll() to watch.  poll() always reports
+   POLLERR, POLLHUP and POLLNVAL in REVENTS, whether or not they are
+   in EVENTS, and ignores entries whose FD is negative. */
+struct pollfd {
+	int fd;                         /* Descriptor. */
+	short events;                   /* Events of interest. */
+	short revents;                  /* Events that occurred. */
+};
+
+/* Events for the epoll calls.  They are the poll() events, plus
+   EPOLLET to report an event once per change instead of for as
+   long as it lasts. */
+#define EPOLLIN POLLIN
+#define EPOLLOUT POLLOUT
+#define EPOLLERR POLLERR
+#define EPOLLHUP POLLHUP
+#define EPOLLET (1u << 31)
+
+/* Operations of epoll_ctl(). */
+enum epoll_op {
+	EPOLL_CTL_ADD = 1,              /* Start watching a descriptor. */
+	EPOLL_CTL_DEL,                  /* Stop watching it. */
+	EPOLL_CTL_MOD,                  /* Change its events or data. */
+};
+
+/* An event reported by epoll_wait(), or the interest passed to
+   epoll_ctl(). */
+struct epoll_event {
+	uint32_t events;                /* Events. */
+	uint64_t data;                  /* Returned as given to epoll_ctl(). */
+};
+
+#endif /* lib/poll.h */
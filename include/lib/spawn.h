@@ -0,0 +1,22 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File descriptor actions for the spawn system call, shared by the
+   kernel and user programs.  The child starts with a copy of its
+   parent's descriptors, and the actions are applied to that copy
+   in order before the child runs. */
+enum spawn_action_type {
+	SPAWN_CLOSE,                /* Close FD. */
+	SPAWN_DUP2,                 /* Make NEWFD refer to FD's file. */
+};
+
+struct spawn_action {
+	int type;                   /* An enum spawn_action_type. */
+	int fd;
+	int newfd;                  /* For SPAWN_DUP2 only. */
+};
+
+/* Most actions one spawn may take. */
+#define SPAWN_ACTIONS_MAX 16
+
+#endif /* lib/spawn.h */
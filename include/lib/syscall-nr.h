@@ -36,6 +36,20 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extensions. */
+	SYS_GETPID,                 /* Obtain the caller's process id. */
+	SYS_WAIT_ANY,               /* Wait for any child process to die. */
+	SYS_SPAWN,                  /* Start a new process running a program. */
+	SYS_THREAD_CREATE,          /* Start a new thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* Exit the calling thread. */
+	SYS_FUTEX,                  /* Sleep on or wake a user memory word. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_POLL,                   /* Wait for descriptors to be ready. */
+	SYS_EPOLL_CREATE,           /* Create an interest set. */
+	SYS_EPOLL_CTL,              /* Change an interest set. */
+	SYS_EPOLL_WAIT,             /* Wait for an interest set's events. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,17 @@
+#ifndef __LIB_USER_PTHREAD_H
+#define __LIB_USER_PTHREAD_H
+
+#include <debug.h>
+
+/* A subset of POSIX threads on top of thread_create(), with no
+   attributes: every thread is joinable, and gets a stack of
+   64 kB. */
+
+/* Thread identifier. */
+typedef int pthread_t;
+
+int pthread_create (pthread_t *, void *(*start) (void *), void *arg);
+int pthread_join (pthread_t, void **retval);
+void pthread_exit (void *retval) NO_RETURN;
+
+#endif /* lib/user/pthread.h */
@@ -0,0 +1,53 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Synchronization for the threads of a user process, built on
+   the futex system call.  Taking a free lock, releasing a lock
+   nobody waits for, and the like, stay in user mode; only a thread
+   that must sleep or wake a sleeper enters the kernel.  Every
+   object may be initialized to all zeros instead of with its init
+   function, or statically with its initializer macro. */
+
+/* A lock.  STATE is 0 if the lock is free, 1 if it is held, and 2
+   if it is held and threads may be sleeping on it. */
+struct lock {
+	int state;
+};
+
+#define LOCK_INITIALIZER { 0 }
+
+void lock_init (struct lock *);
+void lock_acquire (struct lock *);
+bool lock_try_acquire (struct lock *);
+void lock_release (struct lock *);
+
+/* A condition variable.  SEQ changes with every signal, so that a
+   waiter can tell whether one came after it released the lock. */
+struct condition {
+	int seq;
+	int waiters;                /* Threads in cond_wait(). */
+};
+
+#define COND_INITIALIZER { 0, 0 }
+
+void cond_init (struct condition *);
+void cond_wait (struct condition *, struct lock *);
+void cond_signal (struct condition *);
+void cond_broadcast (struct condition *);
+
+/* A counting semaphore. */
+struct semaphore {
+	int value;
+	int waiters;                /* Threads in sema_down(). */
+};
+
+#define SEMA_INITIALIZER(VALUE) { (VALUE), 0 }
+
+void sema_init (struct semaphore *, int value);
+void sema_down (struct semaphore *);
+bool sema_try_down (struct semaphore *);
+void sema_up (struct semaphore *);
+
+#endif /* lib/user/synch.h */
@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <futex.h>
+#include <poll.h>
+#include <spawn.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -38,6 +41,22 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+/* Extensions. */
+pid_t getpid (void);
+pid_t wait_any (int *status);
+pid_t spawn (const char *path, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt);
+int thread_create (void (*entry) (void *, void *), void *arg0, void *arg1);
+int thread_join (int tid, void **retval);
+void thread_exit (void *retval) NO_RETURN;
+int futex (int *uaddr, int op, int val, long timeout_ms);
+int pipe (int fds[2]);
+int poll (struct pollfd *fds, unsigned nfds, int timeout_ms);
+int epoll_create (void);
+int epoll_ctl (int epfd, int op, int fd, struct epoll_event *event);
+int epoll_wait (int epfd, struct epoll_event *events, int maxevents,
+		int timeout_ms);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
@@ -0,0 +1,17 @@
+#ifndef THREADS_KSTACK_H
+#define THREADS_KSTACK_H
+
+#include <stdbool.h>
+#include "threads/vaddr.h"
+
+/* Pages in a kernel stack, and its size in bytes. */
+#define KSTACK_PAGES 4
+#define KSTACK_SIZE (KSTACK_PAGES * PGSIZE)
+
+void kstack_init (void);
+void *kstack_alloc (void);
+void kstack_free (void *);
+bool kstack_is_guard (const void *);
+void kstack_print_stats (void);
+
+#endif /* threads/kstack.h */
@@ -2,12 +2,59 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <list.h>
 #include <stddef.h>
+#include "threads/synch.h"
 
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_print_stats (void);
+
+/* Objects a magazine holds. */
+#define KMEM_MAG_SIZE 32
+
+/* Objects moved between a magazine and the slabs at once. */
+#define KMEM_MAG_BATCH (KMEM_MAG_SIZE / 2)
+
+/* Prepares a newly carved object.  An object must be in its
+   constructed state again when it is freed. */
+typedef void kmem_ctor_func (void *obj);
+
+/* A CPU's stack of free objects, used without taking the cache's
+   lock. */
+struct kmem_magazine {
+	size_t cnt;                 /* Objects in OBJS. */
+	void *objs[KMEM_MAG_SIZE];
+};
+
+/* A cache of equally sized objects, carved from one-page slabs. */
+struct kmem_cache {
+	const char *name;           /* For statistics. */
+	size_t obj_size;            /* Bytes in each object. */
+	size_t obj_ofs;             /* Offset of the first object in a slab. */
+	size_t objs_per_slab;       /* Objects in a slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or a null pointer. */
+
+	struct lock lock;           /* Protects the members below. */
+	struct list partial_slabs;  /* Slabs with free and used objects. */
+	size_t slab_cnt;            /* Slabs in use. */
+	size_t obj_cnt;             /* Objects handed out by the slabs. */
+
+	/* One per CPU; Pintos has one. */
+	struct kmem_magazine mag;
+
+	unsigned long long alloc_cnt;       /* Allocations so far. */
+	unsigned long long req_bytes;       /* Bytes they asked for. */
+	struct list_elem elem;      /* Element in the list of caches. */
+};
+
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+		kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void *kmem_cache_zalloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
 
 #endif /* threads/malloc.h */
@@ -0,0 +1,36 @@
+#ifndef THREADS_POLLQ_H
+#define THREADS_POLLQ_H
+
+#include <list.h>
+
+/* Readiness queues.
+
+   An object that may become readable or writable, such as a pipe
+   or the keyboard, keeps a queue of waiters.  Each waiter has a
+   function that the object calls, with the events that occurred,
+   whenever its readiness changes.  The function runs with
+   interrupts off, perhaps in an interrupt handler, so it must not
+   sleep.
+
+   Queues are protected by turning interrupts off, so that
+   interrupt handlers may wake them. */
+struct poll_waiter;
+typedef void poll_wake_func (struct poll_waiter *, unsigned events);
+
+struct poll_queue {
+	struct list waiters;            /* struct poll_waiter. */
+};
+
+struct poll_waiter {
+	struct list_elem elem;          /* In QUEUE's list. */
+	struct poll_queue *queue;       /* Queue, or null if on none. */
+	poll_wake_func *wake;           /* Called on events. */
+};
+
+void poll_queue_init (struct poll_queue *);
+void poll_waiter_init (struct poll_waiter *, poll_wake_func *);
+void poll_queue_add (struct poll_queue *, struct poll_waiter *);
+void poll_queue_remove (struct poll_waiter *);
+void poll_queue_wake (struct poll_queue *, unsigned events);
+
+#endif /* threads/pollq.h */
@@ -41,5 +41,15 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=2 MB page (PDEs only). */
+#define PTE_G 0x100                      /* 1=global, kept across CR3 loads. */
+
+/* A page directory entry with PTE_PS set maps a 2 MB "large page"
+   directly, with no page table below it.  It then has the same
+   flags as a PTE, and serves as the PTE of every 4 kB page within
+   the large page. */
+#define LGPGSIZE (1UL << PDXSHIFT)       /* Bytes in a large page. */
+#define LGPG_CNT (LGPGSIZE / PGSIZE)     /* 4 kB pages in a large page. */
+#define LGPTE_ADDR(pde) ((uint64_t) (pde) & ~(LGPGSIZE - 1))
 
 #endif /* threads/pte.h */
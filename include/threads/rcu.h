@@ -0,0 +1,39 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A callback waiting for a grace period, embedded in the object
+   it frees. */
+struct rcu_head {
+	struct list_elem elem;
+	void (*func) (struct rcu_head *);
+};
+
+void rcu_init (void);
+void synchronize_rcu (void);
+void call_rcu (struct rcu_head *, void (*func) (struct rcu_head *));
+void rcu_read_unlock (void);
+
+/* Enters an RCU read-side critical section.  Sections nest.  The
+   thread is not preempted inside one, and must not sleep. */
+static inline void
+rcu_read_lock (void) {
+	thread_current ()->rcu_nesting++;
+	barrier ();
+}
+
+/* Reads pointer P for use inside a read-side critical section. */
+#define rcu_dereference(P) (*(__typeof__ (P) volatile *) &(P))
+
+/* Publishes V, whose contents must already be initialized, in
+   pointer P for readers to find. */
+#define rcu_assign_pointer(P, V)                                \
+	do {                                                    \
+		barrier ();                                     \
+		*(__typeof__ (P) volatile *) &(P) = (V);        \
+	} while (0)
+
+#endif /* threads/rcu.h */
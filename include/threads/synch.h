@@ -3,11 +3,36 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* A thread's place in a wait queue. */
+struct wait_elem {
+	struct wait_elem *child;    /* First child. */
+	struct wait_elem *next;     /* Next sibling. */
+	struct wait_elem *prev;     /* Previous sibling, or the parent of
+	                               a first child. */
+	uint64_t seq;               /* When the thread started waiting. */
+};
+
+/* Threads waiting on a semaphore or condition variable.
+
+   A pairing heap ordered by priority, and by arrival among equal
+   priorities, so the next thread to wake is always at the root.
+   Adding a thread takes constant time, and taking the root or
+   moving a thread whose priority changed takes logarithmic time,
+   amortized.  Interrupts must be off to use one. */
+struct wait_queue {
+	struct wait_elem *root;     /* Next thread to wake, or null. */
+};
+
+void wait_queue_update (struct thread *);
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -16,22 +41,37 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-/* Lock. */
+/* Lock.
+
+   Every lock keeps contention statistics, updated only by the
+   thread that holds it.  Locks given a name with lock_set_name()
+   are listed at shutdown by lock_print_stats(). */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct list_elem held_elem; /* In the holder's list of held locks. */
+
+	const char *name;           /* Name for statistics, or null. */
+	struct list_elem elem;      /* In the list of named locks. */
+	uint64_t acquired_at;       /* TSC when the holder acquired it. */
+	uint64_t acquire_cnt;       /* Acquisitions. */
+	uint64_t contended_cnt;     /* Of those, ones that found it held. */
+	uint64_t wait_cycles;       /* Cycles spent waiting to acquire it. */
+	uint64_t max_hold_cycles;   /* Longest it has been held. */
 };
- 
+
 void lock_init (struct lock *);
+void lock_set_name (struct lock *, const char *name);
+void lock_print_stats (void);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
-bool donate_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux);
+void lock_update_priority (struct thread *);
 bool lock_held_by_current_thread (const struct lock *);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void cond_init (struct condition *);
@@ -39,8 +79,38 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-bool cond_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux);
-bool sema_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux);
+/* Reader-writer lock.
+
+   Any number of readers may hold it at once, or one writer.  A
+   writer holds LOCK for as long as it holds the reader-writer
+   lock, so threads waiting behind it donate their priority to it
+   just as they would for a plain lock.  A writer waiting for the
+   readers inside to leave donates its priority to each of them. */
+struct rwlock {
+	struct lock lock;           /* Held by a writer, and briefly by a
+	                               reader on its way in. */
+	unsigned readers;           /* Readers holding the lock. */
+	struct list holds;          /* Their struct rwlock_holds. */
+	bool draining;              /* Is a writer waiting for READERS to
+	                               reach zero? */
+	struct semaphore drained;   /* Upped when they do. */
+};
+
+/* One thread's hold on a reader-writer lock for reading. */
+struct rwlock_hold {
+	struct rwlock *rwlock;      /* Lock held, or null if unused. */
+	struct thread *thread;      /* Holder. */
+	struct list_elem elem;      /* In RWLOCK's HOLDS. */
+};
+
+/* Reader-writer locks a thread may hold for reading at once. */
+#define RWLOCK_READ_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
 
 /* Optimization barrier.
  *
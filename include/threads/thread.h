@@ -26,8 +26,10 @@ enum thread_status {
    You can redefine this to whatever type you like. */
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
-#define maxfd 30
-#define maxet 30
+
+/* Bytes saved by fxsave. */
+#define FPU_STATE_SIZE 512
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
@@ -35,106 +37,120 @@ typedef int tid_t;
 
 /* A kernel thread or user process.
  *
- * Each thread structure is stored in its own 4 kB page.  The
- * thread structure itself sits at the very bottom of the page
- * (at offset 0).  The rest of the page is reserved for the
- * thread's kernel stack, which grows downward from the top of
- * the page (at offset 4 kB).  Here's an illustration:
+ * Each thread structure is stored in its own 4 kB page, which it
+ * may fill.  The thread's kernel stack is allocated separately by
+ * kstack_alloc(): KSTACK_SIZE (16 kB) bytes in a region of kernel
+ * virtual memory set aside for stacks, with an unmapped guard page
+ * below each one.  Here's an illustration:
  *
- *      4 kB +---------------------------------+
- *           |          kernel stack           |
- *           |                |                |
- *           |                |                |
- *           |                V                |
- *           |         grows downward          |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           |                                 |
- *           +---------------------------------+
- *           |              magic              |
- *           |            intr_frame           |
- *           |                :                |
- *           |                :                |
- *           |               name              |
- *           |              status             |
- *      0 kB +---------------------------------+
+ *     struct thread page           kernel stack slot
  *
- * The upshot of this is twofold:
+ *      4 kB +---------------+  20 kB +---------------------------+
+ *           |     magic     |        |        kernel stack       |
+ *           |   intr_frame  |        |             |             |
+ *           |       :       |        |             V             |
+ *           |      name     |        |       grows downward      |
+ *           |     status    |   4 kB +---------------------------+
+ *      0 kB +---------------+        |  guard page, never mapped |
+ *                               0 kB +---------------------------+
  *
- *    1. First, `struct thread' must not be allowed to grow too
- *       big.  If it does, then there will not be enough room for
- *       the kernel stack.  Our base `struct thread' is only a
- *       few bytes in size.  It probably should stay well under 1
- *       kB.
+ * A stack that overflows faults on its guard page instead of
+ * corrupting other memory.  The CPU cannot push the page fault's
+ * frame onto the overflowed stack either, so the fault becomes a
+ * double fault, which runs on a stack of its own and panics.
+ * (Only kernels built with USERPROG have the TSS that stack
+ * switch needs; in others the machine resets.)
  *
- *    2. Second, kernel stacks must not be allowed to grow too
- *       large.  If a stack overflows, it will corrupt the thread
- *       state.  Thus, kernel functions should not allocate large
- *       structures or arrays as non-static local variables.  Use
- *       dynamic allocation with malloc() or palloc_get_page()
- *       instead.
+ * Kernel functions should still not put large structures or
+ * arrays in non-static local variables; use malloc() or
+ * palloc_get_page() for those.
  *
- * The first symptom of either of these problems will probably be
- * an assertion failure in thread_current(), which checks that
- * the `magic' member of the running thread's `struct thread' is
- * set to THREAD_MAGIC.  Stack overflow will normally change this
- * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
-
-
-struct child_status
-{
-	tid_t tid;  
-	int exit_status;
-};
+ * The initial thread, which runs main(), is the exception: its
+ * structure and stack share the page the loader set up, as in
+ * the original Pintos design, with no guard page. */
+/* The `elem' member has more than one purpose.  It can be an
+ * element in the run queue, in the list of threads sleeping in
+ * thread_sleep(), or in the list of dying threads whose pages
+ * are yet to be freed (all in thread.c).  It can be used these
+ * ways only because they are mutually exclusive: only a thread
+ * in the ready state is on the run queue, only a blocked one is
+ * asleep, and only a dying one is to be freed.  A thread blocked
+ * on a semaphore or condition variable is instead in that wait
+ * queue's pairing heap, through `wait_elem' (synch.c). */
+
 struct thread {
 	/* Owned by thread.c. */
 	tid_t tid;                          /* Thread identifier. */
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	void *kstack;                       /* Kernel stack, or null for the
+	                                       initial thread. */
 	int time;
 	int original_priority;
 	int nice;
 	int recent_cpu;
-	struct list donation_list;	
-	struct list child_list;
-	struct lock *lock;
 	/* Shared between thread.c and synch.c. */
+	struct list held_locks;             /* Locks held, for donation. */
+	struct lock *lock;                  /* Lock waited for, or null. */
+	struct rwlock *rwlock;              /* Reader-writer lock whose readers
+	                                       it waits for, or null. */
+	struct rwlock_hold read_holds[RWLOCK_READ_MAX]; /* For reading. */
 	struct list_elem all_elem;
-	struct list_elem donate_elem;
 	struct list_elem elem;              /* List element. */
-	struct list_elem child_elem;
-
-	/* Owned by userprog/process.c. */
+	struct wait_queue *wait_queue;      /* Queue waited on, or null. */
+	struct wait_elem wait_elem;         /* Place in WAIT_QUEUE. */
+
+	/* Shared between thread.c and rcu.c. */
+	int rcu_nesting;                    /* Depth of RCU read-side critical
+	                                       sections. */
+	bool rcu_yield;                     /* Yield on leaving them? */
+
+	/* Owned by userprog/process.c.
+
+	   A process is a main thread and the threads made in it by the
+	   thread_create system call.  PROC points to the main thread,
+	   which for the main thread itself, like for a kernel thread, is
+	   the thread.  Fields marked "main" are used only in the main
+	   thread and belong to the whole process.  The other threads
+	   share its page table and descriptors through copies of PML4
+	   and FDT. */
+	struct thread *proc;                /* Main thread of the process. */
 	uint64_t *pml4;                     /* Page map level 4 */
-	struct file *fdt[maxfd];
-	struct child_status *est[maxfd];
-	int exit_status;
-	struct intr_frame f;
+	struct fd_table *fdt;               /* Open file descriptors. */
+	struct join_record *join_record;    /* Non-main: for thread_join(). */
+	int stack_slot;                     /* Non-main: user stack slot. */
+	void *bounce_page;                  /* Kept by uaccess_bounce_put(). */
+	struct child_status *exit_record;   /* Main: shared with the parent,
+	                                       or null. */
+	struct list children;               /* Main: children still running. */
+	struct list exited_children;        /* Main: children not yet waited
+	                                       for. */
+	struct condition child_exited;      /* Main: signaled when a child
+	                                       exits. */
+	struct list join_records;           /* Main: other threads' records. */
+	struct condition thread_exited;     /* Main: signaled when one of the
+	                                       other threads exits. */
+	int thread_cnt;                     /* Main: other threads running. */
+	uint64_t stack_slots;               /* Main: user stack slots in use. */
+	bool exiting;                       /* Main: is the process exiting? */
+	int exit_status;                    /* Main: process's exit status. */
 	struct file* exec_file;
-	struct semaphore *wait_sema;
-	struct semaphore *fork_sema;
-	struct thread *parent;
-	bool user_exit;
-	bool is_waited;
+	bool user_exit;                     /* Main: print an exit message? */
 
 #ifdef VM
-	/* Table for whole virtual memory owned by thread. */
+	/* Main: table for whole virtual memory owned by the process. */
 	struct supplemental_page_table spt;
+	void *user_rsp;                     /* User rsp at system call entry. */
 #endif
 
 	/* Owned by thread.c. */
+#ifdef USERPROG
+	/* User x87 and SSE registers while they are not loaded.  The
+	   kernel itself never uses them. */
+	uint8_t fpu[FPU_STATE_SIZE] __attribute__ ((aligned (16)));
+	bool fpu_user;                      /* Has it entered user mode? */
+#endif
 	struct intr_frame tf;               /* Information for switching */
 	unsigned magic;                     /* Detects stack overflow. */
 };
@@ -178,6 +194,11 @@ void do_iret (struct intr_frame *tf);
 // int64_t get_min_time(void);
 void thread_sleep(int64_t time);
 void thread_wake(int64_t tick);
+void thread_wake_early (struct thread *);
+#ifdef USERPROG
+void thread_fpu_acquire (void);
+void thread_fpu_copy (struct thread *);
+#endif
 void thread_preempt(void);
 void thread_calculate_priority(struct thread *t);
 void calculate_priority(void);
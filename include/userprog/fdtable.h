@@ -0,0 +1,57 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+struct file;
+
+/* Most descriptors a process may have open at once.  One bit per
+   64 descriptors marks the full words of the open bitmap, and
+   with this many that summary fits in a single word. */
+#define FD_MAX 4096
+
+/* Entries that stand for the console rather than a file. */
+#define FD_CONSOLE_IN ((struct file *) 1)
+#define FD_CONSOLE_OUT ((struct file *) 2)
+
+/* A process's file descriptors.
+
+   FILES grows by doubling as descriptors are opened.  Bit N of
+   OPEN is set if descriptor N is open, and bit N of FULL is set
+   if all 64 descriptors in word N of OPEN are, so finding the
+   lowest free descriptor takes two bit scans.
+
+   All the threads of a process share its table, so the functions
+   that change it take LOCK.  fd_get() takes none: it reads FILES
+   inside an RCU read-side critical section, and an old FILES, or
+   a file dropped from it, is let go only after a grace period.  A
+   file returned by fd_get() holds a reference of its own, which
+   keeps it open if another thread closes the descriptor meanwhile.
+   The entry for a descriptor that is not open is null. */
+struct fd_table {
+	struct lock lock;           /* Serializes changes to the rest. */
+	struct file **files;        /* Open file for each descriptor. */
+	uint64_t *open;             /* Bitmap of open descriptors. */
+	uint64_t full;              /* Bitmap of full words in OPEN. */
+	int capacity;               /* Entries in FILES, a multiple of 64. */
+};
+
+struct fd_table *fd_table_create (void);
+struct fd_table *fd_table_copy (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+
+int fd_install (struct fd_table *, struct file *);
+struct file *fd_get (struct fd_table *, int fd);
+void fd_put (struct fd_table *, struct file *);
+bool fd_close (struct fd_table *, int fd);
+int fd_dup2 (struct fd_table *, int oldfd, int newfd);
+
+/* Returns true if FILE is one of the console entries. */
+static inline bool
+fd_is_console (struct file *file) {
+	return file == FD_CONSOLE_IN || file == FD_CONSOLE_OUT;
+}
+
+#endif /* userprog/fdtable.h */
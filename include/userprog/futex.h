@@ -0,0 +1,14 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+void futex_init (void);
+int futex_wait (int *uaddr, int val, int64_t timeout_ms);
+int futex_wake (int *uaddr, int cnt);
+void futex_frame_moved (void *kva);
+
+struct thread;
+void futex_cancel (struct thread *proc);
+
+#endif /* userprog/futex.h */
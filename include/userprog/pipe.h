@@ -0,0 +1,27 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+
+/* Returned by pipe_read() and pipe_write() for a bad user buffer. */
+#define PIPE_FAULT (-2)
+
+/* Writes of at most this many bytes, a page, are atomic. */
+#define PIPE_BUF 4096
+
+struct pipe;
+struct poll_waiter;
+struct thread;
+
+void pipe_init (void);
+struct pipe *pipe_create (void);
+void pipe_open_end (struct pipe *, bool writer);
+void pipe_close_end (struct pipe *, bool writer);
+void pipe_watch (struct pipe *);
+void pipe_unwatch (struct pipe *);
+int pipe_read (struct pipe *, void *ubuf, unsigned size);
+int pipe_write (struct pipe *, const void *ubuf, unsigned size);
+unsigned pipe_poll (struct pipe *, bool writer, struct poll_waiter *);
+void pipe_cancel (struct thread *proc);
+
+#endif /* userprog/pipe.h */
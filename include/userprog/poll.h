@@ -0,0 +1,29 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Returned by poll_fds() and epoll_wait() for a bad user buffer. */
+#define POLL_FAULT (-2)
+
+struct epoll;
+struct file;
+struct poll_waiter;
+struct thread;
+
+void poll_init (void);
+int poll_fds (struct pollfd *ufds, unsigned nfds, int64_t timeout_ms);
+void poll_cancel (struct thread *proc);
+
+struct epoll *epoll_create (void);
+void epoll_open (struct epoll *);
+void epoll_close (struct epoll *);
+int epoll_ctl (struct epoll *, int op, int fd, struct file *,
+		const struct epoll_event *);
+int epoll_wait (struct epoll *, struct epoll_event *uevents, int maxevents,
+		int64_t timeout_ms);
+unsigned epoll_poll (struct epoll *, struct poll_waiter *);
+
+#endif /* userprog/poll.h */
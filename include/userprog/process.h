@@ -1,13 +1,27 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <debug.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include "threads/thread.h"
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_spawn (char *cmd_line, const struct spawn_action *,
+		size_t action_cnt);
 int process_exec (void *f_name);
 int process_wait (tid_t);
+tid_t process_wait_any (int *exit_status);
 void process_exit (void);
+void process_terminate (int status) NO_RETURN;
+bool process_single_threaded (void);
+tid_t process_thread_create (uint64_t entry, uint64_t arg0, uint64_t arg1);
+bool process_thread_join (tid_t, uint64_t *retval);
+void process_thread_exit (uint64_t retval) NO_RETURN;
 void process_activate (struct thread *next);
+void child_status_init (void);
 
 #endif /* userprog/process.h */
@@ -1,7 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/synch.h"
+
+/* Serializes file system access. */
+extern struct lock filesys_lock;
+
 void syscall_init (void);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
-
@@ -22,6 +22,9 @@ struct task_state {
 	uint16_t iomb;
 }__attribute__ ((packed));
 
+/* IST slot, 1 through 7, of the double fault handler's stack. */
+#define TSS_IST_DOUBLE_FAULT 1
+
 struct task_state;
 void tss_init (void);
 struct task_state *tss_get (void);
@@ -0,0 +1,24 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/interrupt.h"
+
+/* Access to user memory from system calls.  These touch user
+   memory directly and recover from faults instead of walking the
+   page table in advance.  Each returns failure if any byte lies
+   outside user memory or cannot be accessed. */
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+long strncpy_from_user (char *dst, const char *usrc, size_t size);
+
+/* A kernel page to copy user data through, so that a fault on the
+   user buffer happens outside any lock. */
+void *uaccess_bounce_get (void);
+void uaccess_bounce_put (void *page);
+void uaccess_bounce_free (void);
+
+bool uaccess_fixup (struct intr_frame *);
+
+#endif /* userprog/uaccess.h */
@@ -5,6 +5,8 @@ struct page;
 enum vm_type;
 
 struct anon_page {
+	size_t swap_slot;           /* Slot on the swap disk holding the
+	                               contents, or BITMAP_ERROR if resident. */
 };
 
 void vm_anon_init (void);
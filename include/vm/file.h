@@ -5,12 +5,31 @@
 
 struct page;
 enum vm_type;
+struct supplemental_page_table;
+
+/* One mmap() region: the unit that munmap() removes. */
+struct mmap_file {
+	void *addr;                 /* First mapped page. */
+	size_t page_cnt;            /* Number of pages mapped. */
+	struct file *file;          /* Private reopened handle to the file. */
+	struct fault_stream stream; /* Faults within the region. */
+	struct list_elem elem;      /* Element in the SPT's mmaps list. */
+};
 
 struct file_page {
+	struct file *file;          /* Backing file, owned by MAP. */
+	off_t ofs;                  /* Offset of this page in FILE. */
+	size_t read_bytes;          /* Bytes backed by FILE; the rest is 0. */
+	struct mmap_file *map;      /* Region this page belongs to. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+struct frame *file_backed_lookup (struct page *page);
+struct fault_stream *file_backed_stream (struct page *page);
+bool file_backed_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void file_backed_kill (struct supplemental_page_table *spt);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
@@ -1,6 +1,8 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -24,6 +26,12 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Recent faults on one region of memory, to detect sequential access. */
+struct fault_stream {
+	void *next;                 /* Page a sequential scan faults on next. */
+	size_t window;              /* Pages to read ahead of such a fault. */
+};
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
@@ -36,6 +44,22 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Marks the pages of a user stack. */
+#define VM_STACK VM_MARKER_0
+
+/* Default stack_limit: 1 MB. */
+#define STACK_LIMIT_DEFAULT (1 << 20)
+
+/* Most pages claimed by one stack growth fault. */
+#define STACK_GROW_PAGES 4
+
+/* Size of the aligned block of neighbours mapped around a fault. */
+#define FAULT_AROUND_PAGES 16
+
+/* Bounds of the read-ahead window of a sequential stream, in pages. */
+#define READAHEAD_MIN_PAGES 2
+#define READAHEAD_MAX_PAGES 32
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -46,6 +70,12 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;     /* Element in the owner's SPT. */
+	struct list_elem frame_elem;   /* Element in frame's mapper list. */
+	struct thread *owner;          /* Main thread of the process whose
+	                                  page table maps VA. */
+	bool writable;                 /* Mapped read/write? */
+	bool zero_mapped;              /* Mapping the zero page read-only? */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -63,6 +93,11 @@ struct page {
 struct frame {
 	void *kva;
 	struct page *page;
+
+	struct list mappers;           /* Pages mapping this frame. More than
+	                                  one only for shared file pages. */
+	struct list_elem elem;         /* Element in the frame table. */
+	bool pinned;                   /* Not to be chosen for eviction. */
 };
 
 /* The function table for page operations.
@@ -85,6 +120,9 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	struct hash pages;             /* Pages, keyed by user virtual address. */
+	struct list mmaps;             /* Live mmap() regions (struct mmap_file). */
+	struct fault_stream stream;    /* Faults outside mmap() regions. */
 };
 
 #include "threads/thread.h"
@@ -98,6 +136,7 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -107,6 +146,16 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+void *vm_user_kva (const void *va, bool bring_in);
 enum vm_type page_get_type (struct page *page);
+void vm_frame_unlink (struct page *page);
+void vm_zero_unmap (struct page *page);
+bool vm_lock (void);
+void vm_unlock (bool locked);
+
+extern size_t stack_limit;
+extern bool vm_huge_pages;
+extern bool vm_prefetch;
+bool vm_is_stack_access (void *addr, void *rsp);
 
 #endif  /* VM_VM_H */
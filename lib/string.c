@@ -1,5 +1,60 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move a word at a time once the
+   destination is aligned.  x86 tolerates the unaligned loads that
+   leaves on the source side, and a load that stays inside one
+   aligned word cannot fault where a byte load would not.  Blocks of
+   at least REP_MIN bytes go to rep movsq and rep stosq instead,
+   which the CPU runs a cache line at a time; fork copies whole
+   pages and palloc zeroes them.
+
+   The user library links SSE2 versions of some of these in ahead of
+   this file; see lib/user/string-sse2.S. */
+#pragma weak memcpy
+#pragma weak memset
+#pragma weak memcmp
+#pragma weak strlen
+
+#define REP_MIN 512
+
+/* A machine word that may alias any other type. */
+typedef uint64_t word_t __attribute__ ((__may_alias__));
+#define WORD_SIZE sizeof (word_t)
+
+/* Word with every byte set to 0x01 and to 0x80, respectively. */
+#define ONES ((word_t) 0x0101010101010101ULL)
+#define HIGHS ((word_t) 0x8080808080808080ULL)
+
+/* True if any byte of W is zero. */
+#define HAS_ZERO(W) ((((W) - ONES) & ~(W) & HIGHS) != 0)
+
+/* True if P is aligned to a word. */
+#define WORD_ALIGNED(P) ((uintptr_t) (P) % WORD_SIZE == 0)
+
+/* Copies SIZE bytes from SRC to DST from the lowest address up,
+   which is safe for overlapping blocks as long as DST <= SRC. */
+static void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) {
+	for (; size > 0 && !WORD_ALIGNED (dst); size--)
+		*dst++ = *src++;
+
+	if (size >= REP_MIN) {
+		size_t cnt = size / WORD_SIZE;
+		__asm __volatile ("rep movsq"
+				: "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+		size %= WORD_SIZE;
+	} else
+		for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+			*(word_t *) dst = *(const word_t *) src;
+			dst += WORD_SIZE;
+			src += WORD_SIZE;
+		}
+
+	while (size-- > 0)
+		*dst++ = *src++;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,9 +66,7 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
-
+	copy_forward (dst, src, size);
 	return dst_;
 }
 
@@ -27,17 +80,25 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
+	if (dst <= src || dst >= src + size)
+		copy_forward (dst, src, size);
+	else {
+		/* Copy from the top down, so that no byte of SRC is
+		   overwritten before it is read. */
 		dst += size;
 		src += size;
+		for (; size > 0 && !WORD_ALIGNED (dst); size--)
+			*--dst = *--src;
+		for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+			dst -= WORD_SIZE;
+			src -= WORD_SIZE;
+			*(word_t *) dst = *(const word_t *) src;
+		}
 		while (size-- > 0)
 			*--dst = *--src;
 	}
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +113,12 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip equal words; the byte loop finds the difference. */
+	for (; size >= WORD_SIZE; size -= WORD_SIZE, a += WORD_SIZE,
+			b += WORD_SIZE)
+		if (*(const word_t *) a != *(const word_t *) b)
+			break;
+
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -257,9 +324,24 @@ strtok_r (char *s, const char *delimiters, char **save_ptr) {
 void *
 memset (void *dst_, int value, size_t size) {
 	unsigned char *dst = dst_;
+	word_t pattern = ONES * (unsigned char) value;
 
 	ASSERT (dst != NULL || size == 0);
 
+	for (; size > 0 && !WORD_ALIGNED (dst); size--)
+		*dst++ = value;
+
+	if (size >= REP_MIN) {
+		size_t cnt = size / WORD_SIZE;
+		__asm __volatile ("rep stosq"
+				: "+D" (dst), "+c" (cnt) : "a" (pattern) : "memory");
+		size %= WORD_SIZE;
+	} else
+		for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+			*(word_t *) dst = pattern;
+			dst += WORD_SIZE;
+		}
+
 	while (size-- > 0)
 		*dst++ = value;
 
@@ -273,8 +355,13 @@ strlen (const char *string) {
 
 	ASSERT (string);
 
-	for (p = string; *p != '\0'; p++)
-		continue;
+	for (p = string; !WORD_ALIGNED (p); p++)
+		if (*p == '\0')
+			return p - string;
+	while (!HAS_ZERO (*(const word_t *) p))
+		p += WORD_SIZE;
+	while (*p != '\0')
+		p++;
 	return p - string;
 }
 
@@ -0,0 +1,40 @@
+#include <pthread.h>
+#include <syscall.h>
+
+/* Runs START on ARG in a new thread, and exits the thread with
+   its return value. */
+static void
+start_routine (void *start_, void *arg) {
+	void *(*start) (void *) = start_;
+
+	thread_exit (start (arg));
+}
+
+/* Starts a thread that calls START with ARG, and stores its
+   identifier in *THREAD.  Returns 0 if successful, or -1 if the
+   process has too many threads or the kernel is out of memory. */
+int
+pthread_create (pthread_t *thread, void *(*start) (void *), void *arg) {
+	int tid = thread_create (start_routine, (void *) start, arg);
+
+	if (tid < 0)
+		return -1;
+	*thread = tid;
+	return 0;
+}
+
+/* Waits for THREAD to exit, and stores the value it returned or
+   passed to pthread_exit() in *RETVAL, unless RETVAL is null.
+   Returns 0 if successful, or -1 if THREAD cannot be joined. */
+int
+pthread_join (pthread_t thread, void **retval) {
+	return thread_join (thread, retval) < 0 ? -1 : 0;
+}
+
+/* Exits the calling thread with RETVAL.  In the initial thread,
+   the process exits with status 0 once all its other threads
+   have exited. */
+void
+pthread_exit (void *retval) {
+	thread_exit (retval);
+}
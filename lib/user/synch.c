@@ -0,0 +1,152 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The locks follow "mutex2" in Ulrich Drepper, "Futexes Are
+   Tricky", 2011.  All atomic operations are sequentially
+   consistent. */
+
+/* If *P holds OLD, stores NEW in it.  Returns what *P held. */
+static int
+cas (int *p, int old, int new) {
+	__atomic_compare_exchange_n (p, &old, new, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return old;
+}
+
+/* Sleeps on *P as long as it holds VAL. */
+static void
+futex_sleep (int *p, int val) {
+	futex (p, FUTEX_WAIT, val, -1);
+}
+
+/* Wakes up to CNT threads sleeping on *P. */
+static void
+futex_wakeup (int *p, int cnt) {
+	futex (p, FUTEX_WAKE, cnt, -1);
+}
+
+/* Initializes LOCK, which is then free. */
+void
+lock_init (struct lock *lock) {
+	lock->state = 0;
+}
+
+/* Acquires LOCK, sleeping until it is free if necessary. */
+void
+lock_acquire (struct lock *lock) {
+	int c = cas (&lock->state, 0, 1);
+
+	if (c == 0)
+		return;
+
+	/* Mark the lock contended before sleeping, so the holder knows
+	   to wake someone.  Having slept, take it contended too, since
+	   others may still be sleeping. */
+	if (c != 2)
+		c = __atomic_exchange_n (&lock->state, 2, __ATOMIC_SEQ_CST);
+	while (c != 0) {
+		futex_sleep (&lock->state, 2);
+		c = __atomic_exchange_n (&lock->state, 2, __ATOMIC_SEQ_CST);
+	}
+}
+
+/* Acquires LOCK if it is free.  Returns true if successful. */
+bool
+lock_try_acquire (struct lock *lock) {
+	return cas (&lock->state, 0, 1) == 0;
+}
+
+/* Releases LOCK, which the caller must hold. */
+void
+lock_release (struct lock *lock) {
+	if (__atomic_fetch_sub (&lock->state, 1, __ATOMIC_SEQ_CST) != 1) {
+		__atomic_store_n (&lock->state, 0, __ATOMIC_SEQ_CST);
+		futex_wakeup (&lock->state, 1);
+	}
+}
+
+/* Initializes COND. */
+void
+cond_init (struct condition *cond) {
+	cond->seq = 0;
+	cond->waiters = 0;
+}
+
+/* Atomically releases LOCK and waits for COND to be signaled, then
+   reacquires LOCK.  May return without a signal, so callers must
+   check their condition again in a loop. */
+void
+cond_wait (struct condition *cond, struct lock *lock) {
+	int seq = __atomic_load_n (&cond->seq, __ATOMIC_SEQ_CST);
+
+	__atomic_fetch_add (&cond->waiters, 1, __ATOMIC_SEQ_CST);
+	lock_release (lock);
+	futex_sleep (&cond->seq, seq);
+	__atomic_fetch_sub (&cond->waiters, 1, __ATOMIC_SEQ_CST);
+
+	/* Other waiters woken by a broadcast may be about to sleep on
+	   LOCK. */
+	while (__atomic_exchange_n (&lock->state, 2, __ATOMIC_SEQ_CST) != 0)
+		futex_sleep (&lock->state, 2);
+}
+
+/* Wakes one thread waiting on COND, if any.  The caller should
+   hold the lock the waiters passed to cond_wait(). */
+void
+cond_signal (struct condition *cond) {
+	if (__atomic_load_n (&cond->waiters, __ATOMIC_SEQ_CST) == 0)
+		return;
+	__atomic_fetch_add (&cond->seq, 1, __ATOMIC_SEQ_CST);
+	futex_wakeup (&cond->seq, 1);
+}
+
+/* Wakes every thread waiting on COND. */
+void
+cond_broadcast (struct condition *cond) {
+	if (__atomic_load_n (&cond->waiters, __ATOMIC_SEQ_CST) == 0)
+		return;
+	__atomic_fetch_add (&cond->seq, 1, __ATOMIC_SEQ_CST);
+	futex_wakeup (&cond->seq, INT_MAX);
+}
+
+/* Initializes SEMA to VALUE. */
+void
+sema_init (struct semaphore *sema, int value) {
+	sema->value = value;
+	sema->waiters = 0;
+}
+
+/* Waits for SEMA's value to become positive and decrements it. */
+void
+sema_down (struct semaphore *sema) {
+	while (!sema_try_down (sema)) {
+		/* Announce ourselves before checking the value one last
+		   time in the kernel, so that sema_up() either sees us or
+		   changes the value first. */
+		__atomic_fetch_add (&sema->waiters, 1, __ATOMIC_SEQ_CST);
+		futex_sleep (&sema->value, 0);
+		__atomic_fetch_sub (&sema->waiters, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+/* Decrements SEMA's value if it is positive.  Returns true if
+   successful. */
+bool
+sema_try_down (struct semaphore *sema) {
+	int value = __atomic_load_n (&sema->value, __ATOMIC_SEQ_CST);
+
+	while (value > 0)
+		if (__atomic_compare_exchange_n (&sema->value, &value, value - 1,
+					false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			return true;
+	return false;
+}
+
+/* Increments SEMA's value and wakes a waiter, if any. */
+void
+sema_up (struct semaphore *sema) {
+	__atomic_fetch_add (&sema->value, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n (&sema->waiters, __ATOMIC_SEQ_CST) != 0)
+		futex_wakeup (&sema->value, 1);
+}
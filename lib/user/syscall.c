@@ -25,7 +25,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			"syscall\n"
 			: "=a" (ret)
 			: "g" (num), "g" (a1), "g" (a2), "g" (a3), "g" (a4), "g" (a5), "g" (a6)
-			: "cc", "memory");
+			: "cc", "memory", "rcx", "r11");
 	return ret;
 }
 
@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -194,3 +194,67 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+pid_t
+getpid (void) {
+	return (pid_t) syscall0 (SYS_GETPID);
+}
+
+pid_t
+wait_any (int *status) {
+	return (pid_t) syscall1 (SYS_WAIT_ANY, status);
+}
+
+pid_t
+spawn (const char *path, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt) {
+	return (pid_t) syscall4 (SYS_SPAWN, path, argv, actions, action_cnt);
+}
+
+int
+thread_create (void (*entry) (void *, void *), void *arg0, void *arg1) {
+	return (int) syscall3 (SYS_THREAD_CREATE, entry, arg0, arg1);
+}
+
+int
+thread_join (int tid, void **retval) {
+	return (int) syscall2 (SYS_THREAD_JOIN, tid, retval);
+}
+
+void
+thread_exit (void *retval) {
+	syscall1 (SYS_THREAD_EXIT, retval);
+	NOT_REACHED ();
+}
+
+int
+futex (int *uaddr, int op, int val, long timeout_ms) {
+	return (int) syscall4 (SYS_FUTEX, uaddr, op, val, timeout_ms);
+}
+
+int
+pipe (int fds[2]) {
+	return (int) syscall1 (SYS_PIPE, fds);
+}
+
+int
+poll (struct pollfd *fds, unsigned nfds, int timeout_ms) {
+	return (int) syscall3 (SYS_POLL, fds, nfds, timeout_ms);
+}
+
+int
+epoll_create (void) {
+	return (int) syscall0 (SYS_EPOLL_CREATE);
+}
+
+int
+epoll_ctl (int epfd, int op, int fd, struct epoll_event *event) {
+	return (int) syscall4 (SYS_EPOLL_CTL, epfd, op, fd, event);
+}
+
+int
+epoll_wait (int epfd, struct epoll_event *events, int maxevents,
+		int timeout_ms) {
+	return (int) syscall4 (SYS_EPOLL_WAIT, epfd, events, maxevents,
+			timeout_ms);
+}
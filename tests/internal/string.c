@@ -0,0 +1,203 @@
+/* Test program and microbenchmark for the block functions in
+   lib/string.c.
+
+   Checks memcpy, memmove, memset, memcmp and strlen against
+   byte-at-a-time reference loops for every alignment of source
+   and destination and a range of sizes, then times each on small
+   blocks and on a full page against its reference loop.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "intrinsic.h"
+
+/* Largest block we check, and the size of the buffers. */
+#define MAX_SIZE 4096
+#define BUF_SIZE (MAX_SIZE + 64)
+
+/* Times each timed operation is repeated. */
+#define REPEAT 64
+
+static unsigned char src[BUF_SIZE], dst[BUF_SIZE], ref[BUF_SIZE];
+
+static void *ref_memcpy (void *, const void *, size_t);
+static void *ref_memset (void *, int, size_t);
+static int ref_memcmp (const void *, const void *, size_t);
+static size_t ref_strlen (const char *);
+static void check_copy (size_t dst_ofs, size_t src_ofs, size_t size);
+static void check_compare (size_t ofs, size_t size);
+static void bench (size_t size);
+
+/* Sizes we check, chosen around the word size and the point where
+   rep movsq takes over. */
+static const size_t sizes[] =
+  {0, 1, 7, 8, 9, 15, 16, 31, 64, 100, 511, 512, 513, 1000, MAX_SIZE};
+
+/* Test and time the string functions. */
+void
+test (void)
+{
+  size_t i, dst_ofs, src_ofs;
+
+  printf ("testing sizes:");
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      printf (" %zu", sizes[i]);
+      for (dst_ofs = 0; dst_ofs < 16; dst_ofs++)
+        {
+          check_compare (dst_ofs, sizes[i]);
+          for (src_ofs = 0; src_ofs < 16; src_ofs++)
+            check_copy (dst_ofs, src_ofs, sizes[i]);
+        }
+    }
+  printf (" done\n");
+
+  bench (64);
+  bench (MAX_SIZE);
+  printf ("string: PASS\n");
+}
+
+/* Fills BUF with random bytes, none of them zero. */
+static void
+fill (unsigned char *buf, size_t size)
+{
+  size_t i;
+
+  random_bytes (buf, size);
+  for (i = 0; i < size; i++)
+    if (buf[i] == 0)
+      buf[i] = 1;
+}
+
+/* Checks memcpy, memmove, memset and strlen for one combination of
+   alignments and size. */
+static void
+check_copy (size_t dst_ofs, size_t src_ofs, size_t size)
+{
+  int value = random_ulong ();
+
+  fill (src, sizeof src);
+  fill (dst, sizeof dst);
+  memcpy (ref, dst, sizeof ref);
+
+  ref_memcpy (ref + dst_ofs, src + src_ofs, size);
+  ASSERT (memcpy (dst + dst_ofs, src + src_ofs, size) == dst + dst_ofs);
+  ASSERT (!ref_memcmp (dst, ref, sizeof dst));
+
+  ref_memset (ref + dst_ofs, value, size);
+  ASSERT (memset (dst + dst_ofs, value, size) == dst + dst_ofs);
+  ASSERT (!ref_memcmp (dst, ref, sizeof dst));
+
+  /* Overlapping moves in both directions, within DST. */
+  ASSERT (memmove (dst + dst_ofs, dst + src_ofs, size) == dst + dst_ofs);
+  ASSERT (!ref_memcmp (dst + dst_ofs, ref + src_ofs, size));
+
+  src[src_ofs + size] = '\0';
+  ASSERT (strlen ((char *) src + src_ofs) == size);
+}
+
+/* Checks memcmp on equal blocks and on blocks that differ in one
+   byte. */
+static void
+check_compare (size_t ofs, size_t size)
+{
+  size_t at;
+
+  fill (src, sizeof src);
+  memcpy (dst, src, sizeof dst);
+  ASSERT (memcmp (src + ofs, dst + ofs, size) == 0);
+  if (size == 0)
+    return;
+
+  at = ofs + random_ulong () % size;
+  dst[at]++;
+  ASSERT (memcmp (src + ofs, dst + ofs, size)
+          == ref_memcmp (src + ofs, dst + ofs, size));
+  ASSERT (memcmp (dst + ofs, src + ofs, size)
+          == ref_memcmp (dst + ofs, src + ofs, size));
+}
+
+/* Keeps the compiler from dropping the timed calls. */
+static volatile uintptr_t sink;
+
+/* Cycles EXPR took to evaluate, on average over REPEAT runs. */
+#define TIME(EXPR)                                      \
+  ({                                                    \
+    uint64_t start_ = rdtsc ();                         \
+    int i_;                                             \
+    for (i_ = 0; i_ < REPEAT; i_++)                     \
+      sink = (uintptr_t) (EXPR);                        \
+    (unsigned long long) ((rdtsc () - start_) / REPEAT); \
+  })
+
+/* Prints the cycles each function takes on SIZE bytes next to its
+   reference loop. */
+static void
+bench (size_t size)
+{
+  fill (src, sizeof src);
+  src[size] = '\0';
+
+  printf ("%zu bytes, optimized vs. byte loop, in cycles:\n", size);
+  printf ("  memcpy %llu vs. %llu\n",
+          TIME (memcpy (dst, src, size)), TIME (ref_memcpy (dst, src, size)));
+  printf ("  memset %llu vs. %llu\n",
+          TIME (memset (dst, 0, size)), TIME (ref_memset (dst, 0, size)));
+  memcpy (dst, src, size);
+  printf ("  memcmp %llu vs. %llu\n",
+          TIME (memcmp (dst, src, size)), TIME (ref_memcmp (dst, src, size)));
+  printf ("  strlen %llu vs. %llu\n",
+          TIME (strlen ((char *) src)), TIME (ref_strlen ((char *) src)));
+}
+
+/* The byte-at-a-time versions the optimized ones replaced. */
+
+static void *
+ref_memcpy (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static void *
+ref_memset (void *dst_, int value, size_t size)
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static int
+ref_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static size_t
+ref_strlen (const char *string)
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
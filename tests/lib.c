@@ -5,7 +5,8 @@
 #include <string.h>
 #include <syscall.h>
 
-const char *test_name;
+/* Weak, so that a child program may define its own. */
+const char *test_name __attribute__ ((weak));
 bool quiet = false;
 
 static void
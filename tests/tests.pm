@@ -164,6 +164,11 @@ sub compare_output {
 			&& !/^ esi=.* edi=.* esp=.* ebp=.*/
 			&& !/^ cs=.* ds=.* es=.* ss=.*/, @output);
     }
+    my $ignore_bench_results = exists $options{IGNORE_BENCH_RESULTS};
+    if ($ignore_bench_results) {
+	delete $options{IGNORE_BENCH_RESULTS};
+	@output = grep (!/^\([^)]+\) bench: /, @output);
+    }
     die "unknown option " . (keys (%options))[0] . "\n" if %options;
 
     my ($msg);
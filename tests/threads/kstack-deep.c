@@ -0,0 +1,57 @@
+/* Runs a thread that uses 12 kB of its kernel stack, three times
+   what fit when a thread's stack shared a page with its struct
+   thread, and checks that the data it left on the way down is
+   intact on the way back up. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Bytes of stack each level of recursion takes, and levels. */
+#define FRAME_SIZE 512
+#define DEPTH 24
+
+static thread_func deep_thread;
+static struct semaphore done;
+static bool intact;
+
+void
+test_kstack_deep (void) 
+{
+  sema_init (&done, 0);
+  thread_create ("deep", PRI_DEFAULT, deep_thread, NULL);
+  sema_down (&done);
+
+  if (!intact)
+    fail ("stack contents changed during recursion");
+  msg ("recursed %d levels of %d bytes", DEPTH, FRAME_SIZE);
+}
+
+/* Fills a frame-sized buffer with LEVEL, recurses, and returns
+   true if the buffers at this level and all those below it still
+   hold what was written. */
+static bool
+recurse (int level) 
+{
+  volatile unsigned char buf[FRAME_SIZE];
+  bool ok = true;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = level;
+  if (level + 1 < DEPTH)
+    ok = recurse (level + 1);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != level)
+      ok = false;
+  return ok;
+}
+
+static void
+deep_thread (void *aux UNUSED) 
+{
+  intact = recurse (0);
+  sema_up (&done);
+}
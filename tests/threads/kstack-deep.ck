@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(kstack-deep) begin
+(kstack-deep) recursed 24 levels of 512 bytes
+(kstack-deep) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Times the page allocator: single pages, which the per-CPU page
+   cache serves, groups of pages of several sizes, which the buddy
+   allocator serves, and groups of pages while every other page of
+   a long run is in use, which used to make the allocator scan past
+   all of them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+#define PAIR_CNT 2000
+#define BATCH_CNT 256
+#define HOLE_CNT 512
+
+static const size_t group_sizes[] = {2, 4, 7, 16, 64};
+
+static void *pages[HOLE_CNT];
+
+void
+test_palloc_bench (void)
+{
+  uint64_t start, cycles;
+  size_t i, j;
+
+  start = rdtsc ();
+  for (j = 0; j < PAIR_CNT; j++)
+    palloc_free_page (palloc_get_page (PAL_ASSERT));
+  cycles = rdtsc () - start;
+  msg ("bench: 1 page: %llu cycles per get and free",
+       (unsigned long long) (cycles / PAIR_CNT));
+
+  start = rdtsc ();
+  for (j = 0; j < BATCH_CNT; j++)
+    pages[j] = palloc_get_page (PAL_ASSERT);
+  for (j = 0; j < BATCH_CNT; j++)
+    palloc_free_page (pages[j]);
+  cycles = rdtsc () - start;
+  msg ("bench: 1 page: %llu cycles per get and free of %d live",
+       (unsigned long long) (cycles / BATCH_CNT), BATCH_CNT);
+
+  for (i = 0; i < sizeof group_sizes / sizeof *group_sizes; i++)
+    {
+      size_t cnt = group_sizes[i];
+
+      start = rdtsc ();
+      for (j = 0; j < PAIR_CNT; j++)
+        palloc_free_multiple (palloc_get_multiple (PAL_ASSERT, cnt), cnt);
+      cycles = rdtsc () - start;
+      msg ("bench: %zu pages: %llu cycles per get and free", cnt,
+           (unsigned long long) (cycles / PAIR_CNT));
+    }
+
+  /* Leave every other page of a long run in use. */
+  for (j = 0; j < HOLE_CNT; j++)
+    pages[j] = palloc_get_page (PAL_ASSERT);
+  for (j = 0; j < HOLE_CNT; j += 2)
+    palloc_free_page (pages[j]);
+
+  start = rdtsc ();
+  for (j = 0; j < PAIR_CNT; j++)
+    palloc_free_multiple (palloc_get_multiple (PAL_ASSERT, 8), 8);
+  cycles = rdtsc () - start;
+  msg ("bench: 8 pages with %d holes: %llu cycles per get and free",
+       HOLE_CNT / 2, (unsigned long long) (cycles / PAIR_CNT));
+
+  for (j = 1; j < HOLE_CNT; j += 2)
+    palloc_free_page (pages[j]);
+  msg ("done");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(palloc-bench) begin
+(palloc-bench) done
+(palloc-bench) end
+EOF
+pass;
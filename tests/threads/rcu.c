@@ -0,0 +1,123 @@
+/* Has reader threads look at a shared version of some data in
+   RCU read-side critical sections, each longer than a time
+   slice, while the main thread keeps replacing it and frees each
+   old version with call_rcu().  Checks that no reader saw a
+   freed version or was preempted inside a section, and that
+   every old version was eventually freed. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 3
+#define UPDATE_CNT 20
+
+/* Timer ticks in a read-side critical section, more than a time
+   slice. */
+#define SECTION_TICKS 5
+
+#define LIVE 0x600d
+#define DEAD 0xdead
+
+struct version 
+  {
+    int value;
+    int magic;
+    struct rcu_head rcu;
+  };
+
+static struct version *current;
+static volatile bool stop;
+static volatile int owner;
+static volatile bool bad;
+static struct semaphore readers_done;
+static struct semaphore retired;
+
+static thread_func reader_thread;
+
+static struct version *
+new_version (int value) 
+{
+  struct version *v = malloc (sizeof *v);
+
+  if (v == NULL)
+    fail ("out of memory");
+  v->value = value;
+  v->magic = LIVE;
+  return v;
+}
+
+static void
+retire_version (struct rcu_head *head) 
+{
+  struct version *v = list_entry (&head->elem, struct version, rcu.elem);
+
+  v->magic = DEAD;
+  free (v);
+  sema_up (&retired);
+}
+
+void
+test_rcu (void) 
+{
+  int i;
+
+  sema_init (&readers_done, 0);
+  sema_init (&retired, 0);
+  current = new_version (0);
+
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT, reader_thread, (void *) (intptr_t) i);
+
+  for (i = 1; i <= UPDATE_CNT; i++) 
+    {
+      struct version *old = current;
+
+      rcu_assign_pointer (current, new_version (i));
+      call_rcu (&old->rcu, retire_version);
+      timer_sleep (1);
+    }
+
+  stop = true;
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&readers_done);
+  synchronize_rcu ();
+  for (i = 0; i < UPDATE_CNT; i++)
+    sema_down (&retired);
+
+  if (bad)
+    fail ("a reader saw a freed version or was preempted");
+  msg ("readers saw only live versions, in order, without being preempted");
+  msg ("all %d old versions were freed", UPDATE_CNT);
+  free (current);
+}
+
+static void
+reader_thread (void *id_) 
+{
+  int id = (intptr_t) id_;
+  int last = 0;
+
+  while (!stop) 
+    {
+      struct version *v;
+      int64_t start;
+
+      rcu_read_lock ();
+      v = rcu_dereference (current);
+      owner = id;
+      start = timer_ticks ();
+      while (timer_elapsed (start) < SECTION_TICKS)
+        barrier ();
+      if (v->magic != LIVE || v->value < last || owner != id)
+        bad = true;
+      last = v->value;
+      rcu_read_unlock ();
+    }
+  sema_up (&readers_done);
+}
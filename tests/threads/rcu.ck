@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rcu) begin
+(rcu) readers saw only live versions, in order, without being preempted
+(rcu) all 20 old versions were freed
+(rcu) end
+EOF
+pass;
@@ -0,0 +1,83 @@
+/* Checks that readers share a reader-writer lock, that a writer
+   waits for the readers inside and keeps out readers that come
+   after it, that a reader waiting for a writer donates its
+   priority to it, and that the writer lends it on to the readers
+   it waits for. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread, writer_thread, late_reader_thread;
+
+static struct rwlock rw;
+static struct semaphore gate;
+static int inside;
+static bool writer_done;
+
+void
+test_rwlock (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  sema_init (&gate, 0);
+
+  rwlock_read_acquire (&rw);
+  inside = 1;
+  thread_create ("reader 0", PRI_DEFAULT + 1, reader_thread, (void *) (intptr_t) 0);
+  thread_create ("reader 1", PRI_DEFAULT + 1, reader_thread, (void *) (intptr_t) 1);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("late reader", PRI_DEFAULT + 2, late_reader_thread, NULL);
+
+  msg ("main releasing its read lock, priority %d", thread_get_priority ());
+  inside--;
+  rwlock_read_release (&rw);
+  msg ("main released its read lock, priority %d", thread_get_priority ());
+  sema_up (&gate);
+  sema_up (&gate);
+}
+
+static void
+reader_thread (void *id_) 
+{
+  int id = (intptr_t) id_;
+
+  rwlock_read_acquire (&rw);
+  inside++;
+  msg ("reader %d acquired the lock with %d readers inside", id, inside);
+  sema_down (&gate);
+  msg ("reader %d releasing the lock, priority %d",
+       id, thread_get_priority ());
+  inside--;
+  rwlock_read_release (&rw);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("writer acquiring the lock");
+  rwlock_write_acquire (&rw);
+  msg ("writer acquired the lock with %d readers inside, priority %d",
+       inside, thread_get_priority ());
+  writer_done = true;
+  rwlock_write_release (&rw);
+}
+
+static void
+late_reader_thread (void *aux UNUSED) 
+{
+  msg ("late reader acquiring the lock");
+  rwlock_read_acquire (&rw);
+  if (!writer_done)
+    fail ("late reader got in ahead of the writer");
+  msg ("late reader acquired the lock after the writer");
+  rwlock_read_release (&rw);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock) begin
+(rwlock) reader 0 acquired the lock with 2 readers inside
+(rwlock) reader 1 acquired the lock with 3 readers inside
+(rwlock) writer acquiring the lock
+(rwlock) late reader acquiring the lock
+(rwlock) main releasing its read lock, priority 33
+(rwlock) main released its read lock, priority 31
+(rwlock) reader 0 releasing the lock, priority 33
+(rwlock) reader 1 releasing the lock, priority 33
+(rwlock) writer acquired the lock with 0 readers inside, priority 33
+(rwlock) late reader acquired the lock after the writer
+(rwlock) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Times sema_up() on a semaphore that 1000 threads of assorted
+   priorities wait on, which used to scan every waiter for the
+   highest priority, and checks that they wake highest priority
+   first and in arrival order among equals. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define WAITER_CNT 1000
+
+static struct semaphore sema;
+static int order[WAITER_CNT];
+static int woken;
+
+/* Returns the priority of waiter ID, above ours so that it runs
+   as soon as it is created or woken. */
+static int
+waiter_priority (int id)
+{
+  return PRI_DEFAULT + 1 + id % (PRI_MAX - PRI_DEFAULT);
+}
+
+static void
+waiter (void *id_)
+{
+  int id = (intptr_t) id_;
+
+  sema_down (&sema);
+  order[woken++] = id;
+}
+
+void
+test_sema_bench (void)
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&sema, 0);
+  for (i = 0; i < WAITER_CNT; i++)
+    if (thread_create ("waiter", waiter_priority (i), waiter,
+                       (void *) (intptr_t) i) == TID_ERROR)
+      fail ("thread_create failed");
+
+  /* Each waiter runs to completion inside its sema_up(). */
+  start = rdtsc ();
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_up (&sema);
+  cycles = rdtsc () - start;
+  msg ("bench: sema_up waking %d waiters: %llu cycles per wakeup",
+       WAITER_CNT, (unsigned long long) cycles / WAITER_CNT);
+
+  if (woken != WAITER_CNT)
+    fail ("%d of %d waiters woke", woken, WAITER_CNT);
+  for (i = 1; i < WAITER_CNT; i++)
+    {
+      int a = waiter_priority (order[i - 1]), b = waiter_priority (order[i]);
+
+      if (a < b || (a == b && order[i - 1] > order[i]))
+        fail ("waiter %d woke before waiter %d", order[i - 1], order[i]);
+    }
+  msg ("done");
+}
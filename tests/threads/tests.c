@@ -29,6 +29,13 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"malloc-bench", test_malloc_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"thread-create-bench", test_thread_create_bench},
+    {"kstack-deep", test_kstack_deep},
+    {"rwlock", test_rwlock},
+    {"rcu", test_rcu},
+    {"sema-bench", test_sema_bench},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -0,0 +1,65 @@
+/* Times thread_create(), whose thread page is a PAL_ZERO page,
+   once with the zeroed page reserve filled by the idle thread and
+   once with the reserve used up, so that every page is zeroed on
+   the spot as it was before the reserve existed. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define CREATE_CNT 16
+#define HOLD_CNT 256
+
+static void *held[HOLD_CNT];
+
+static void
+exit_func (void *aux UNUSED)
+{
+}
+
+/* Returns the average cycles thread_create() took for CREATE_CNT
+   threads, which run only once the caller sleeps. */
+static uint64_t
+time_creates (void)
+{
+  uint64_t cycles = 0;
+  int i;
+
+  for (i = 0; i < CREATE_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      tid_t tid = thread_create ("bench", PRI_DEFAULT - 1, exit_func, NULL);
+      cycles += rdtsc () - start;
+      if (tid == TID_ERROR)
+        fail ("thread_create failed");
+    }
+  return cycles / CREATE_CNT;
+}
+
+void
+test_thread_create_bench (void)
+{
+  uint64_t cycles;
+  int i;
+
+  /* Give the idle thread time to fill the reserve. */
+  timer_sleep (10);
+  cycles = time_creates ();
+  msg ("bench: thread_create with zeroed pages: %llu cycles",
+       (unsigned long long) cycles);
+  timer_sleep (10);
+
+  /* Hold on to the reserve and then some. */
+  for (i = 0; i < HOLD_CNT; i++)
+    held[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  cycles = time_creates ();
+  msg ("bench: thread_create zeroing its page: %llu cycles",
+       (unsigned long long) cycles);
+  for (i = 0; i < HOLD_CNT; i++)
+    palloc_free_page (held[i]);
+  timer_sleep (10);
+  msg ("done");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(thread-create-bench) begin
+(thread-create-bench) done
+(thread-create-bench) end
+EOF
+pass;
@@ -7,7 +7,7 @@
 
 const char *test_name = "child-simple";
 int
-main (void) 
+main (int argc UNUSED, char *argv[] UNUSED) 
 {
   msg ("run");
   return 81;
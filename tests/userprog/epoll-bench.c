@@ -0,0 +1,89 @@
+/* Times waiting for one ready pipe out of many, with poll() over
+   all of them and with an interest set holding all of them.  Each
+   round writes a byte to one pipe, waits for it, and reads it
+   back.  poll() takes time in proportion to the pipes, and
+   epoll_wait() in proportion to those that are ready. */
+
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIPE_CNT 1000
+#define ROUNDS 200
+
+static int pipes[PIPE_CNT][2];
+static struct pollfd pfds[PIPE_CNT];
+
+/* Returns the average cycles per round of writing to a pipe and
+   waiting for it with poll(). */
+static uint64_t
+time_poll (void)
+{
+  uint64_t start = rdtsc ();
+  int r, i;
+  char c;
+
+  for (r = 0; r < ROUNDS; r++)
+    {
+      int chosen = r * 7 % PIPE_CNT;
+
+      write (pipes[chosen][1], "x", 1);
+      if (poll (pfds, PIPE_CNT, -1) != 1)
+        fail ("poll failed");
+      for (i = 0; i < PIPE_CNT; i++)
+        if (pfds[i].revents != 0 && i != chosen)
+          fail ("poll reported pipe %d", i);
+      read (pipes[chosen][0], &c, 1);
+    }
+  return (rdtsc () - start) / ROUNDS;
+}
+
+/* Returns the average cycles per round of writing to a pipe and
+   waiting for it with epoll_wait() on EPFD. */
+static uint64_t
+time_epoll (int epfd)
+{
+  uint64_t start = rdtsc ();
+  struct epoll_event ev;
+  int r;
+  char c;
+
+  for (r = 0; r < ROUNDS; r++)
+    {
+      int chosen = r * 7 % PIPE_CNT;
+
+      write (pipes[chosen][1], "x", 1);
+      if (epoll_wait (epfd, &ev, 1, -1) != 1 || ev.data != (uint64_t) chosen)
+        fail ("epoll_wait failed");
+      read (pipes[chosen][0], &c, 1);
+    }
+  return (rdtsc () - start) / ROUNDS;
+}
+
+void
+test_main (void)
+{
+  struct epoll_event ev;
+  int epfd, i;
+
+  epfd = epoll_create ();
+  if (epfd < 0)
+    fail ("epoll_create failed");
+  for (i = 0; i < PIPE_CNT; i++)
+    {
+      if (pipe (pipes[i]) != 0)
+        fail ("pipe %d failed", i);
+      pfds[i].fd = pipes[i][0];
+      pfds[i].events = POLLIN;
+      ev.events = EPOLLIN;
+      ev.data = i;
+      if (epoll_ctl (epfd, EPOLL_CTL_ADD, pipes[i][0], &ev) != 0)
+        fail ("epoll_ctl %d failed", i);
+    }
+
+  msg ("bench: poll, %d pipes: %llu cycles", PIPE_CNT,
+       (unsigned long long) time_poll ());
+  msg ("bench: epoll, %d pipes: %llu cycles", PIPE_CNT,
+       (unsigned long long) time_epoll (epfd));
+}
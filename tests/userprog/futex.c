@@ -0,0 +1,124 @@
+/* Checks the futex system call, then uses the user-space lock,
+   condition variable and semaphore built on it from several
+   threads: a counter bumped under a lock, a bounded buffer
+   guarded by semaphores, and a flag awaited with a condition
+   variable. */
+
+#include <pthread.h>
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITERATIONS 2000
+#define ITEM_CNT 500
+#define BUF_SIZE 8
+
+static struct lock counter_lock;
+static volatile int counter;
+
+static void *
+bump_counter (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      int value;
+
+      lock_acquire (&counter_lock);
+      value = counter;
+      /* Widen the window for a timer interrupt. */
+      for (volatile int j = 0; j < 20; j++)
+        continue;
+      counter = value + 1;
+      lock_release (&counter_lock);
+    }
+  return NULL;
+}
+
+static struct semaphore empty, full;
+static struct lock buf_lock;
+static int buf[BUF_SIZE];
+static int head, tail;
+
+static void *
+produce (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 1; i <= ITEM_CNT; i++)
+    {
+      sema_down (&empty);
+      lock_acquire (&buf_lock);
+      buf[head++ % BUF_SIZE] = i;
+      lock_release (&buf_lock);
+      sema_up (&full);
+    }
+  return NULL;
+}
+
+static struct lock flag_lock;
+static struct condition flag_set;
+static bool flag;
+
+static void *
+set_flag (void *aux UNUSED)
+{
+  lock_acquire (&flag_lock);
+  flag = true;
+  cond_signal (&flag_set);
+  lock_release (&flag_lock);
+  return NULL;
+}
+
+void
+test_main (void) 
+{
+  pthread_t threads[THREAD_CNT], producer, setter;
+  int word = 0;
+  long sum = 0;
+  int i;
+
+  CHECK (futex (&word, FUTEX_WAIT, 1, -1) == FUTEX_MISMATCH,
+         "wait on a word that changed");
+  CHECK (futex (&word, FUTEX_WAIT, 0, 30) == FUTEX_TIMEDOUT,
+         "wait with a timeout");
+  CHECK (futex (&word, FUTEX_WAKE, 1, -1) == 0, "wake with no sleepers");
+
+  lock_init (&counter_lock);
+  for (i = 0; i < THREAD_CNT; i++)
+    if (pthread_create (&threads[i], bump_counter, NULL) != 0)
+      fail ("pthread_create #%d failed", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    pthread_join (threads[i], NULL);
+  CHECK (counter == THREAD_CNT * ITERATIONS, "counter is %d", counter);
+
+  sema_init (&empty, BUF_SIZE);
+  sema_init (&full, 0);
+  lock_init (&buf_lock);
+  if (pthread_create (&producer, produce, NULL) != 0)
+    fail ("pthread_create failed");
+  for (i = 0; i < ITEM_CNT; i++)
+    {
+      sema_down (&full);
+      lock_acquire (&buf_lock);
+      sum += buf[tail++ % BUF_SIZE];
+      lock_release (&buf_lock);
+      sema_up (&empty);
+    }
+  pthread_join (producer, NULL);
+  CHECK (sum == (long) ITEM_CNT * (ITEM_CNT + 1) / 2, "consumed sum %ld", sum);
+
+  lock_init (&flag_lock);
+  cond_init (&flag_set);
+  lock_acquire (&flag_lock);
+  if (pthread_create (&setter, set_flag, NULL) != 0)
+    fail ("pthread_create failed");
+  while (!flag)
+    cond_wait (&flag_set, &flag_lock);
+  lock_release (&flag_lock);
+  pthread_join (setter, NULL);
+  msg ("condition variable signaled");
+}
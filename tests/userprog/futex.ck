@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex) begin
+(futex) wait on a word that changed
+(futex) wait with a timeout
+(futex) wake with no sleepers
+(futex) counter is 8000
+(futex) consumed sum 125250
+(futex) condition variable signaled
+(futex) end
+EOF
+pass;
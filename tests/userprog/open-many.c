@@ -0,0 +1,45 @@
+/* Opens a file many more times than the 64 descriptors a process
+   starts out with room for, checks that a closed descriptor is
+   the next one handed out, and that dup2() can reach a descriptor
+   far past those open and shares the file position with the
+   original. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 1000
+#define DUP_FD 4000
+
+static int handles[OPEN_CNT];
+
+void
+test_main (void) 
+{
+  char buf[10];
+  int i, handle;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, handles[i], handles[i - 1]);
+    }
+  msg ("open \"sample.txt\" %d times", OPEN_CNT);
+
+  close (handles[OPEN_CNT / 2]);
+  CHECK ((handle = open ("sample.txt")) == handles[OPEN_CNT / 2],
+         "reopen gets the closed descriptor");
+
+  CHECK (dup2 (handles[0], DUP_FD) == DUP_FD, "dup2 to descriptor %d", DUP_FD);
+  CHECK (read (DUP_FD, buf, sizeof buf) == sizeof buf,
+         "read from descriptor %d", DUP_FD);
+  CHECK (tell (handles[0]) == sizeof buf, "original shares the position");
+
+  msg ("close all");
+  for (i = 0; i < OPEN_CNT; i++)
+    close (handles[i]);
+  close (DUP_FD);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" 1000 times
+(open-many) reopen gets the closed descriptor
+(open-many) dup2 to descriptor 4000
+(open-many) read from descriptor 4000
+(open-many) original shares the position
+(open-many) close all
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Times moving data through a pipe from a forked child to its
+   parent in 64 kB chunks.  The kernel copies each byte out of the
+   child's memory and into the parent's, but trades whole pages
+   into and out of the pipe's ring instead of copying them there
+   as well. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE (64 * 1024)
+#define CHUNK_CNT 64
+
+static char buf[CHUNK_SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  long long total = 0;
+  int fds[2];
+  int bytes, i;
+  pid_t pid;
+
+  if (pipe (fds) != 0)
+    fail ("pipe failed");
+  for (i = 0; i < CHUNK_SIZE; i++)
+    buf[i] = i;
+
+  start = rdtsc ();
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      close (fds[0]);
+      for (i = 0; i < CHUNK_CNT; i++)
+        if (write (fds[1], buf, CHUNK_SIZE) != CHUNK_SIZE)
+          exit (1);
+      exit (0);
+    }
+  if (pid < 0)
+    fail ("fork failed");
+  close (fds[1]);
+  while ((bytes = read (fds[0], buf, CHUNK_SIZE)) > 0)
+    total += bytes;
+  cycles = rdtsc () - start;
+  if (wait (pid) != 0)
+    fail ("child failed");
+  if (total != (long long) CHUNK_SIZE * CHUNK_CNT)
+    fail ("read %lld bytes", total);
+  msg ("bench: pipe: %llu cycles per kB",
+       (unsigned long long) (cycles / (total / 1024)));
+}
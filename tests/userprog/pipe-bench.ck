@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(pipe-bench) begin
+(pipe-bench) end
+EOF
+pass;
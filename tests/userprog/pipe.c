@@ -0,0 +1,71 @@
+/* Checks pipes: data written comes back in order, each end refuses
+   the other's operation, a forked child's writes reach its parent,
+   a descriptor copied with dup2() keeps the writing end open, and
+   readers see end of file once every writing end is closed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes the child writes, in chunks of CHUNK_SIZE. */
+#define CHILD_BYTES 100000
+#define CHUNK_SIZE 1000
+
+static char buf[CHUNK_SIZE];
+
+void
+test_main (void)
+{
+  int fds[2];
+  int total, bytes;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write 5 bytes");
+  CHECK (read (fds[0], buf, sizeof buf) == 5 && !memcmp (buf, "hello", 5),
+         "read them back");
+  CHECK (read (fds[1], buf, 1) == -1, "read from the writing end");
+  CHECK (write (fds[0], buf, 1) == -1, "write to the reading end");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      int i;
+
+      close (fds[0]);
+      for (total = 0; total < CHILD_BYTES; total += CHUNK_SIZE)
+        {
+          for (i = 0; i < CHUNK_SIZE; i++)
+            buf[i] = (total + i) % 251;
+          if (write (fds[1], buf, CHUNK_SIZE) != CHUNK_SIZE)
+            exit (1);
+        }
+      exit (0);
+    }
+  close (fds[1]);
+  for (total = 0; (bytes = read (fds[0], buf, sizeof buf)) > 0; total += bytes)
+    {
+      int i;
+
+      for (i = 0; i < bytes; i++)
+        if (buf[i] != (char) ((total + i) % 251))
+          fail ("byte %d is %d", total + i, buf[i]);
+    }
+  msg ("read %d bytes from child", total);
+  CHECK (wait (pid) == 0, "wait for child");
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (dup2 (fds[1], 20) == 20, "dup2 the writing end");
+  close (fds[1]);
+  CHECK (write (20, "x", 1) == 1, "write through the copy");
+  close (20);
+  CHECK (read (fds[0], buf, sizeof buf) == 1, "read 1 byte");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "end of file");
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], "x", 1) == -1, "write with no reader");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pipe) begin
+(pipe) pipe
+(pipe) write 5 bytes
+(pipe) read them back
+(pipe) read from the writing end
+(pipe) write to the reading end
+(pipe) read 100000 bytes from child
+(pipe) wait for child
+(pipe) pipe
+(pipe) dup2 the writing end
+(pipe) write through the copy
+(pipe) read 1 byte
+(pipe) end of file
+(pipe) pipe
+(pipe) write with no reader
+(pipe) end
+EOF
+pass;
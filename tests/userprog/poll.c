@@ -0,0 +1,129 @@
+/* Checks poll() and the epoll calls over pipes: readiness without
+   waiting, timeouts, wakeups from a forked child's write, end of
+   file, bad descriptors, and an interest set of many pipes that
+   reports the one written to, level- or edge-triggered.  Pipe ends
+   in the set must close as if they were in none. */
+
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Pipes in the interest set, and the one the child writes to. */
+#define PIPE_CNT 64
+#define CHOSEN 37
+
+static int pipes[PIPE_CNT][2];
+
+void
+test_main (void)
+{
+  struct pollfd pfd[2];
+  struct epoll_event ev;
+  int fds[2];
+  int epfd, i;
+  char c;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pfd[0].fd = fds[0];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = fds[1];
+  pfd[1].events = POLLOUT;
+  CHECK (poll (pfd, 2, 0) == 1 && pfd[0].revents == 0
+         && pfd[1].revents == POLLOUT, "only the writing end is ready");
+  CHECK (poll (pfd, 1, 20) == 0, "poll times out");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      for (volatile int j = 0; j < 100000; j++)
+        continue;
+      write (fds[1], "x", 1);
+      exit (0);
+    }
+  CHECK (poll (pfd, 1, -1) == 1 && pfd[0].revents == POLLIN,
+         "poll wakes on the child's write");
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read the byte");
+  wait (pid);
+
+  close (fds[1]);
+  CHECK (poll (pfd, 1, -1) == 1 && (pfd[0].revents & POLLHUP),
+         "poll reports the writer gone");
+  close (fds[0]);
+  CHECK (poll (pfd, 1, 0) == 1 && pfd[0].revents == POLLNVAL,
+         "poll reports a closed descriptor");
+
+  epfd = epoll_create ();
+  CHECK (epfd >= 0, "epoll_create");
+  for (i = 0; i < PIPE_CNT; i++)
+    {
+      if (pipe (pipes[i]) != 0)
+        fail ("pipe %d failed", i);
+      ev.events = EPOLLIN;
+      ev.data = i;
+      if (epoll_ctl (epfd, EPOLL_CTL_ADD, pipes[i][0], &ev) != 0)
+        fail ("epoll_ctl %d failed", i);
+    }
+  msg ("added %d pipes", PIPE_CNT);
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_ADD, pipes[0][0], &ev) == -1,
+         "adding a descriptor twice fails");
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_ADD, epfd, &ev) == -1,
+         "adding the set to itself fails");
+  CHECK (epoll_wait (epfd, &ev, 1, 20) == 0, "epoll_wait times out");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      for (volatile int j = 0; j < 100000; j++)
+        continue;
+      write (pipes[CHOSEN][1], "y", 1);
+      exit (0);
+    }
+  CHECK (epoll_wait (epfd, &ev, 1, -1) == 1 && ev.data == CHOSEN
+         && ev.events == EPOLLIN, "epoll_wait reports pipe %d", CHOSEN);
+  wait (pid);
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 1 && ev.data == CHOSEN,
+         "reported again while still readable");
+  CHECK (read (pipes[CHOSEN][0], &c, 1) == 1 && c == 'y', "read the byte");
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 0, "not reported once drained");
+
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data = CHOSEN;
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_MOD, pipes[CHOSEN][0], &ev) == 0,
+         "switch pipe %d to edge-triggered", CHOSEN);
+  write (pipes[CHOSEN][1], "z", 1);
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 1 && ev.data == CHOSEN,
+         "edge reported");
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 0, "edge reported only once");
+
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_DEL, pipes[CHOSEN][0], NULL) == 0,
+         "remove pipe %d", CHOSEN);
+  write (pipes[CHOSEN][1], "z", 1);
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 0, "removed pipe not reported");
+
+  pfd[0].fd = epfd;
+  pfd[0].events = POLLIN;
+  close (pipes[3][1]);
+  CHECK (poll (pfd, 1, 0) == 1 && pfd[0].revents == POLLIN,
+         "poll sees the set ready");
+  CHECK (epoll_wait (epfd, &ev, 1, 0) == 1 && ev.data == 3
+         && (ev.events & EPOLLHUP), "epoll_wait reports the writer gone");
+
+  ev.events = EPOLLOUT;
+  ev.data = PIPE_CNT;
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_ADD, pipes[5][1], &ev) == 0,
+         "add the writing end of pipe 5");
+  close (pipes[5][1]);
+  pfd[0].fd = pipes[5][0];
+  pfd[0].events = POLLIN;
+  CHECK (poll (pfd, 1, 0) == 1 && (pfd[0].revents & POLLHUP),
+         "closing it gives poll POLLHUP");
+  CHECK (read (pipes[5][0], &c, 1) == 0, "and read end of file");
+  CHECK (epoll_ctl (epfd, EPOLL_CTL_DEL, pipes[5][1], NULL) == 0,
+         "remove it by its closed descriptor");
+  close (pipes[6][0]);
+  CHECK (write (pipes[6][1], "w", 1) == -1,
+         "closing a reading end in the set breaks the pipe");
+  close (epfd);
+}
@@ -0,0 +1,37 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(poll) begin
+(poll) pipe
+(poll) only the writing end is ready
+(poll) poll times out
+(poll) poll wakes on the child's write
+(poll) read the byte
+(poll) poll reports the writer gone
+(poll) poll reports a closed descriptor
+(poll) epoll_create
+(poll) added 64 pipes
+(poll) adding a descriptor twice fails
+(poll) adding the set to itself fails
+(poll) epoll_wait times out
+(poll) epoll_wait reports pipe 37
+(poll) reported again while still readable
+(poll) read the byte
+(poll) not reported once drained
+(poll) switch pipe 37 to edge-triggered
+(poll) edge reported
+(poll) edge reported only once
+(poll) remove pipe 37
+(poll) removed pipe not reported
+(poll) poll sees the set ready
+(poll) epoll_wait reports the writer gone
+(poll) add the writing end of pipe 5
+(poll) closing it gives poll POLLHUP
+(poll) and read end of file
+(poll) remove it by its closed descriptor
+(poll) closing a reading end in the set breaks the pipe
+(poll) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Times starting a program with fork() followed by exec() against
+   starting it with spawn().  The parent first dirties a buffer,
+   which fork() has to copy and exec() then throws away, while
+   spawn() loads the child without looking at the parent's memory.
+   Each time covers the child running and being waited for. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RUN_CNT 16
+#define BUF_SIZE (256 * 1024)
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void)
+{
+  char *argv[] = { "spawn-child", NULL };
+  uint64_t fork_cycles = 0, spawn_cycles = 0;
+  int i;
+
+  memset (buf, 0x5a, sizeof buf);
+
+  for (i = 0; i < RUN_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      pid_t pid = fork ("spawn-child");
+
+      if (pid == 0)
+        {
+          exec ("spawn-child");
+          exit (-1);
+        }
+      if (pid < 0)
+        fail ("fork failed");
+      if (wait (pid) != 0)
+        fail ("fork+exec child failed");
+      fork_cycles += rdtsc () - start;
+    }
+
+  for (i = 0; i < RUN_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      pid_t pid = spawn ("spawn-child", argv, NULL, 0);
+
+      if (pid < 0)
+        fail ("spawn failed");
+      if (wait (pid) != 0)
+        fail ("spawned child failed");
+      spawn_cycles += rdtsc () - start;
+    }
+
+  msg ("bench: fork+exec: %llu cycles",
+       (unsigned long long) (fork_cycles / RUN_CNT));
+  msg ("bench: spawn: %llu cycles",
+       (unsigned long long) (spawn_cycles / RUN_CNT));
+}
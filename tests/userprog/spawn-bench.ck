@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(spawn-bench) begin
+(spawn-bench) end
+EOF
+pass;
@@ -0,0 +1,12 @@
+/* Child process run by spawn-bench.  Exits at once, so that the
+   benchmark times little besides creating the process. */
+
+#include <debug.h>
+
+int main (int, char *[]);
+
+int
+main (int argc UNUSED, char *argv[] UNUSED)
+{
+  return 0;
+}
@@ -0,0 +1,39 @@
+/* Opens a file and spawns child-close with a dup2 action that
+   hands it the file as descriptor 7, which it verifies and closes.
+   The parent's own descriptor must be unaffected.  Spawning a
+   missing program and spawning with an action on a closed
+   descriptor must both fail. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *argv[] = { "child-close", "7", NULL };
+  struct spawn_action actions[2];
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  actions[0].type = SPAWN_DUP2;
+  actions[0].fd = handle;
+  actions[0].newfd = 7;
+  actions[1].type = SPAWN_CLOSE;
+  actions[1].fd = handle;
+  pid = spawn ("child-close", argv, actions, 2);
+  if (pid < 0)
+    fail ("spawn \"child-close 7\" failed");
+  msg ("wait(spawn()) = %d", wait (pid));
+
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+
+  CHECK (spawn ("no-such-file", NULL, NULL, 0) == -1,
+         "spawn \"no-such-file\"");
+  actions[0].fd = 100;
+  CHECK (spawn ("child-close", argv, actions, 1) == -1,
+         "spawn with dup2 of a closed descriptor");
+}
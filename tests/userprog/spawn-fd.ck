@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-fd) begin
+(spawn-fd) open "sample.txt"
+(child-close) begin
+(child-close) verified contents of "sample.txt"
+(child-close) end
+child-close: exit(0)
+(spawn-fd) wait(spawn()) = 0
+(spawn-fd) verified contents of "sample.txt"
+load: no-such-file: open failed
+(spawn-fd) spawn "no-such-file"
+(spawn-fd) spawn with dup2 of a closed descriptor
+(spawn-fd) end
+spawn-fd: exit(0)
+EOF
+pass;
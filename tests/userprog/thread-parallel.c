@@ -0,0 +1,66 @@
+/* Sums an array with several threads of one process, each taking
+   a slice of it and returning its partial sum, and checks that
+   the threads saw the array the main thread filled in, ran on
+   stacks of their own, and can each be joined exactly once. */
+
+#include <pthread.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 8
+#define ELEM_CNT (1 << 16)
+#define SLICE (ELEM_CNT / THREAD_CNT)
+
+static int array[ELEM_CNT];
+static void *stacks[THREAD_CNT];
+
+static void *
+sum_slice (void *slice_)
+{
+  int slice = (int) (long) slice_;
+  long sum = 0;
+  int i;
+
+  stacks[slice] = &sum;
+  for (i = slice * SLICE; i < (slice + 1) * SLICE; i++)
+    sum += array[i];
+  return (void *) sum;
+}
+
+void
+test_main (void) 
+{
+  pthread_t threads[THREAD_CNT];
+  long total = 0;
+  int i, j;
+
+  for (i = 0; i < ELEM_CNT; i++)
+    array[i] = i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (pthread_create (&threads[i], sum_slice, (void *) (long) i) != 0)
+      fail ("pthread_create #%d failed", i);
+  msg ("created %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      void *sum;
+
+      if (pthread_join (threads[i], &sum) != 0)
+        fail ("pthread_join #%d failed", i);
+      total += (long) sum;
+    }
+  msg ("joined %d threads", THREAD_CNT);
+
+  CHECK (total == (long) ELEM_CNT * (ELEM_CNT - 1) / 2,
+         "total is %ld", total);
+  for (i = 0; i < THREAD_CNT; i++)
+    for (j = i + 1; j < THREAD_CNT; j++)
+      if (stacks[i] == stacks[j])
+        fail ("threads %d and %d shared a stack", i, j);
+  msg ("each thread had a stack of its own");
+
+  CHECK (pthread_join (threads[0], NULL) == -1, "join a joined thread");
+  CHECK (thread_join (getpid (), NULL) == -1, "join the main thread");
+}
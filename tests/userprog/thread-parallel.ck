@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thread-parallel) begin
+(thread-parallel) created 8 threads
+(thread-parallel) joined 8 threads
+(thread-parallel) total is 2147450880
+(thread-parallel) each thread had a stack of its own
+(thread-parallel) join a joined thread
+(thread-parallel) join the main thread
+(thread-parallel) end
+EOF
+pass;
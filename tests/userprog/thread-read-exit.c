@@ -0,0 +1,32 @@
+/* Exits while another thread of the process is blocked reading
+   the console, which gets no input.  The reader must be woken for
+   the process to finish exiting. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int started;
+
+static void *
+reader (void *aux UNUSED)
+{
+  char c;
+
+  started = 1;
+  read (STDIN_FILENO, &c, 1);
+  return NULL;
+}
+
+void
+test_main (void) 
+{
+  pthread_t thread;
+
+  CHECK (pthread_create (&thread, reader, NULL) == 0, "create reader");
+  while (!started)
+    continue;
+  exit (57);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-read-exit) begin
+(thread-read-exit) create reader
+thread-read-exit: exit(57)
+EOF
+pass;
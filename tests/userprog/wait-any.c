@@ -0,0 +1,54 @@
+/* Forks more children than a process could once keep exit
+   statuses for, lets them all exit, then waits for the first by
+   pid and for the rest with wait_any(), checking that each status
+   arrives exactly once and that wait_any() fails once none are
+   left. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 50
+
+static pid_t pids[CHILD_CNT];
+static bool reaped[CHILD_CNT];
+
+void
+test_main (void) 
+{
+  int i, status;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pids[i] = fork ("child");
+      if (pids[i] == 0)
+        exit (i + 1);
+      if (pids[i] < 0)
+        fail ("fork #%d returned %d", i, pids[i]);
+    }
+  msg ("forked %d children", CHILD_CNT);
+
+  CHECK (wait (pids[0]) == 1, "wait for first child");
+  reaped[0] = true;
+
+  for (i = 1; i < CHILD_CNT; i++)
+    {
+      pid_t pid = wait_any (&status);
+      int j;
+
+      for (j = 0; j < CHILD_CNT; j++)
+        if (pids[j] == pid)
+          break;
+      if (j == CHILD_CNT)
+        fail ("wait_any returned unknown pid %d", pid);
+      if (reaped[j])
+        fail ("wait_any returned pid %d twice", pid);
+      if (status != j + 1)
+        fail ("child %d exited with %d, expected %d", j, status, j + 1);
+      reaped[j] = true;
+    }
+  msg ("reaped %d more children with wait_any", CHILD_CNT - 1);
+
+  CHECK (wait_any (NULL) == -1, "wait_any with no children left");
+  CHECK (wait (pids[1]) == -1, "wait for a reaped child");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-any) begin
+(wait-any) forked 50 children
+(wait-any) wait for first child
+(wait-any) reaped 49 more children with wait_any
+(wait-any) wait_any with no children left
+(wait-any) wait for a reaped child
+(wait-any) end
+EOF
+pass;
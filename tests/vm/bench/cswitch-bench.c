@@ -0,0 +1,101 @@
+/* Measures what a context switch to another process costs the
+   TLB.  The parent walks a working set of pages over and over
+   while a forked child spins on its own pages.  A pass over the
+   working set that starts right after the parent was switched
+   back in has to refill the TLB unless the kernel kept the
+   parent's entries across the switch, so comparing it against an
+   ordinary pass shows the TLB misses a switch costs. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define WS_PAGES 256            /* Pages in the working set. */
+#define SWITCHES 32             /* Passes after a switch to time. */
+#define WARM_PASSES 256         /* Ordinary passes to time. */
+
+/* Two touches further apart than this had a switch between them. */
+#define SWITCH_GAP 1000000
+
+static volatile char ws[WS_PAGES * PAGE_SIZE];
+
+/* Touches every page of the working set.  Returns false if the
+   pass was interrupted by a switch, so it must not be timed. */
+static bool
+touch_pass (uint64_t *cycles)
+{
+  uint64_t start, prev, now;
+  int i;
+
+  start = prev = rdtsc ();
+  for (i = 0; i < WS_PAGES; i++)
+    {
+      ws[i * PAGE_SIZE]++;
+      now = rdtsc ();
+      if (now - prev > SWITCH_GAP)
+        return false;
+      prev = now;
+    }
+  *cycles = prev - start;
+  return true;
+}
+
+static void
+child (void)
+{
+  uint64_t cycles;
+  int fd;
+
+  for (;;)
+    {
+      touch_pass (&cycles);
+      if ((fd = open ("cswitch-done")) >= 0)
+        {
+          close (fd);
+          exit (0);
+        }
+    }
+}
+
+void
+test_main (void)
+{
+  uint64_t cycles, warm = 0, cold = 0;
+  int warm_cnt = 0, cold_cnt = 0;
+  bool after_switch = false;
+  pid_t pid;
+
+  /* Fault the working set in before anything is timed. */
+  touch_pass (&cycles);
+  while (warm_cnt < WARM_PASSES)
+    if (touch_pass (&cycles))
+      {
+        warm += cycles;
+        warm_cnt++;
+      }
+
+  if ((pid = fork ("child")) == 0)
+    child ();
+
+  /* The first pass after being switched back in is the cold one. */
+  while (cold_cnt < SWITCHES)
+    {
+      if (!touch_pass (&cycles))
+        after_switch = true;
+      else if (after_switch)
+        {
+          cold += cycles;
+          cold_cnt++;
+          after_switch = false;
+        }
+    }
+
+  CHECK (create ("cswitch-done", 0), "create \"cswitch-done\"");
+  CHECK (wait (pid) == 0, "wait for child");
+
+  msg ("bench: %d-page pass: %llu cycles", WS_PAGES,
+       (unsigned long long) (warm / warm_cnt));
+  msg ("bench: %d-page pass after a switch: %llu cycles", WS_PAGES,
+       (unsigned long long) (cold / cold_cnt));
+}
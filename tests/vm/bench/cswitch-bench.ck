@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(cswitch-bench) begin
+(cswitch-bench) create "cswitch-done"
+(cswitch-bench) wait for child
+(cswitch-bench) end
+EOF
+pass;
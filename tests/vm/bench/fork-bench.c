@@ -0,0 +1,33 @@
+/* Times fork(), which allocates the child's thread page and page
+   tables as PAL_ZERO pages.  The parent waits for each child, and
+   the idle time after it exits lets the zeroed page reserve fill
+   up again.  fork-bench-noreserve runs this with -no-zero-reserve,
+   zeroing every page on request, for comparison. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FORK_CNT 32
+
+void
+test_main (void)
+{
+  uint64_t cycles = 0;
+  int i;
+
+  for (i = 0; i < FORK_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      pid_t pid = fork ("child");
+
+      if (pid == 0)
+        exit (0);
+      cycles += rdtsc () - start;
+      if (pid < 0)
+        fail ("fork failed");
+      if (wait (pid) != 0)
+        fail ("wait failed");
+    }
+  msg ("bench: fork: %llu cycles", (unsigned long long) (cycles / FORK_CNT));
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(mmap-read-bench-noprefetch) begin
+(mmap-read-bench-noprefetch) open "large.txt"
+(mmap-read-bench-noprefetch) mmap "large.txt"
+(mmap-read-bench-noprefetch) compare checksums
+(mmap-read-bench-noprefetch) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Reads "large.txt" once with read() and once through a memory
+   mapping, checks that both see the same bytes, and reports the
+   cycles each took.  The mapping faults its pages in lazily and
+   never writes them back, since none are dirtied. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BUF_SIZE (2 * 1024 * 1024)
+
+static char buf[BUF_SIZE];
+
+static uint32_t
+checksum (const char *p, size_t size)
+{
+  uint32_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    sum = sum * 31 + (unsigned char) p[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  uint64_t start, read_cycles, mmap_cycles;
+  uint32_t read_sum, mmap_sum;
+  int handle, size;
+  void *map;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  size = filesize (handle);
+  if (size <= 0 || size > BUF_SIZE)
+    fail ("unexpected size %d of \"large.txt\"", size);
+
+  start = rdtsc ();
+  if (read (handle, buf, size) != size)
+    fail ("read \"large.txt\" failed");
+  read_sum = checksum (buf, size);
+  read_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  CHECK ((map = mmap (actual, size, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"large.txt\"");
+  mmap_sum = checksum (actual, size);
+  munmap (map);
+  mmap_cycles = rdtsc () - start;
+
+  CHECK (read_sum == mmap_sum, "compare checksums");
+  msg ("bench: read %d bytes: %llu cycles", size,
+       (unsigned long long) read_cycles);
+  msg ("bench: mmap %d bytes: %llu cycles", size,
+       (unsigned long long) mmap_cycles);
+  close (handle);
+}
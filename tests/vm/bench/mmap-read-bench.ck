@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(mmap-read-bench) begin
+(mmap-read-bench) open "large.txt"
+(mmap-read-bench) mmap "large.txt"
+(mmap-read-bench) compare checksums
+(mmap-read-bench) end
+EOF
+pass;
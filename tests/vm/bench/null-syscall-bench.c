@@ -0,0 +1,23 @@
+/* Times the round trip of getpid(), which does no work in the
+   kernel, so that what is left is the system call path itself. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CALL_CNT 10000
+
+void
+test_main (void)
+{
+  pid_t pid = getpid ();
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    if (getpid () != pid)
+      fail ("getpid changed");
+  msg ("bench: null syscall: %llu cycles",
+       (unsigned long long) ((rdtsc () - start) / CALL_CNT));
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH_RESULTS => 1, [<<'EOF']);
+(null-syscall-bench) begin
+(null-syscall-bench) end
+EOF
+pass;
@@ -11,6 +11,6 @@ test_main (void)
   int handle;
 
   CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
-  read (handle, (char *) &handle - 4096, 1);
+  read (handle, (char *) ((uintptr_t) &handle - 4096), 1);
   fail ("survived reading data into bad address");
 }
@@ -3,6 +3,7 @@
 #include <debug.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,16 +16,23 @@
 #include "devices/vga.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/kstack.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #endif
@@ -38,6 +46,9 @@
 #include "filesys/fsutil.h"
 #endif
 
+/* CR0 bit that makes ring 0 honor read-only pages. */
+#define CR0_WP (1UL << 16)
+
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
@@ -86,6 +97,7 @@ main (void) {
 	mem_end = palloc_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	kstack_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -100,9 +112,14 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+	child_status_init ();
+	futex_init ();
+	pipe_init ();
+	poll_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	rcu_init ();
 	serial_init_queue ();
 	timer_calibrate ();
 
@@ -151,21 +168,45 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = (uint64_t) &start;
+	uint64_t text_end = (uint64_t) &_end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		// Use a 2 MB page wherever all of it gets the same
+		// permissions; the kernel text is read-only.
+		if (pa % LGPGSIZE == 0 && pa + LGPGSIZE <= mem_end
+				&& (va + LGPGSIZE <= text_start || va >= text_end
+					|| (text_start <= va && va + LGPGSIZE <= text_end))) {
+			perm = PTE_P | PTE_W | PTE_PS | PTE_G;
+			if (text_start <= va && va < text_end)
+				perm &= ~PTE_W;
+
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | perm;
+			pa += LGPGSIZE;
+			continue;
+		}
+
+		perm = PTE_P | PTE_W | PTE_G;
+		if (text_start <= va && va < text_end)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	tlb_init ();
+
+	// Honor read-only pages in the kernel too, so that writes to user
+	// memory fault on read-only and copy-on-write pages, and on the
+	// shared zero page, which vm_init() relies on.
+	lcr0 (rcr0 () | CR0_WP);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -222,11 +263,24 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-no-zero-reserve"))
+			palloc_zero_reserve = false;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-hugepages"))
+			vm_huge_pages = true;
+		else if (!strcmp (name, "-no-prefetch"))
+			vm_prefetch = false;
+		else if (!strcmp (name, "-stack-limit")) {
+			/* Room for at least one stack page above the guard page. */
+			size_t limit = ROUND_UP (atoi (value), PGSIZE);
+			stack_limit = limit > 2 * PGSIZE ? limit : 2 * PGSIZE;
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -327,8 +381,14 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -no-zero-reserve   Zero pages on request, not at idle time.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -hugepages         Map large aligned user regions with 2 MB pages.\n"
+			"  -no-prefetch       Neither fault around nor read ahead.\n"
+			"  -stack-limit=BYTES Limit user stacks to BYTES (default 1 MB).\n"
 #endif
 			);
 	power_off ();
@@ -355,6 +415,10 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	kstack_print_stats ();
+	lock_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,5 +426,10 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	syscall_print_stats ();
+	pml4_print_stats ();
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
 }
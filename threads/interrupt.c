@@ -119,7 +119,7 @@ intr_get_level (void) {
 	   value off the stack into `flags'.  See [IA32-v2b] "PUSHF"
 	   and "POP" and [IA32-v3a] 5.8.1 "Masking Maskable Hardware
 	   Interrupts". */
-	asm volatile ("pushfq; popq %0" : "=g" (flags));
+	asm volatile ("pushfq; popq %0" : "=r" (flags));
 
 	return flags & FLAG_IF ? INTR_ON : INTR_OFF;
 }
@@ -141,7 +141,7 @@ intr_enable (void) {
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
 	   Hardware Interrupts". */
-	asm volatile ("sti");
+	asm volatile ("sti" : : : "memory");
 
 	return old_level;
 }
@@ -252,6 +252,17 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
+/* Makes interrupt VEC_NO, which must already be registered,
+   switch to the stack in entry IST (1 through 7) of the TSS's
+   interrupt stack table, even when it interrupts the kernel.  IST
+   0 restores the usual behavior of staying on the current stack. */
+void
+intr_set_ist (uint8_t vec_no, int ist) {
+	ASSERT (intr_handlers[vec_no] != NULL);
+	ASSERT (ist >= 0 && ist <= 7);
+	idt[vec_no].ist = ist;
+}
+
 /* Returns true during processing of an external interrupt
    and false at all other times. */
 bool
@@ -372,6 +383,15 @@ intr_handler (struct intr_frame *frame) {
 		if (yield_on_return)
 			thread_yield ();
 	}
+
+#ifdef USERPROG
+	/* A thread whose process is exiting never goes back to user
+	   mode. */
+	if (frame->cs == SEL_UCSEG && thread_current ()->proc->exiting) {
+		intr_enable ();
+		thread_exit ();
+	}
+#endif
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
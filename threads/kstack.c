@@ -0,0 +1,212 @@
+#include "threads/kstack.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "intrinsic.h"
+
+/* Kernel stacks.
+
+   Stacks do not come from the mapping of physical memory at
+   KERN_BASE.  They live in a region of kernel virtual memory of
+   their own, divided into slots.  Each slot is an unmapped guard
+   page followed by the KSTACK_PAGES pages of a stack:
+
+        slot + 20 kB +---------------------------------+
+                     |          kernel stack           |
+                     |                |                |
+                     |                V                |
+                     |         grows downward          |
+        slot +  4 kB +---------------------------------+
+                     |     guard page, never mapped    |
+        slot +  0 kB +---------------------------------+
+
+   A stack that overflows runs into the guard page below it and
+   faults, instead of overwriting whatever happens to lie there.
+
+   The region shares its PML4 entry with KERN_BASE.  pml4_create()
+   copies that entry into every page map, so every address space
+   sees a stack as soon as it is mapped into base_pml4.
+
+   A freed stack stays mapped in a small cache, and the next thread
+   created takes it without allocating pages or touching page
+   tables. */
+
+/* Start of the region, and slots in it: the most threads that
+   can exist at once. */
+#define KSTACK_BASE 0xff00000000ULL
+#define KSTACK_SLOTS 4096
+
+/* Bytes in a slot: the guard page and the stack. */
+#define SLOT_SIZE (PGSIZE + KSTACK_SIZE)
+
+/* Freed stacks kept mapped for reuse. */
+#define KSTACK_CACHE_MAX 16
+
+/* Slots in use, whether by a thread or by the cache.  Interrupts
+   are turned off to change it, since stacks are freed inside the
+   scheduler. */
+static struct bitmap *used_slots;
+
+/* Cache of freed stacks, also protected by turning interrupts off. */
+static void *cache[KSTACK_CACHE_MAX];
+static size_t cache_cnt;
+
+/* Serializes creating page tables for the region. */
+static struct lock map_lock;
+
+/* Statistics. */
+static long long alloc_cnt;             /* Stacks handed out. */
+static long long reuse_cnt;             /* Of those, taken from the cache. */
+
+static void unmap_stack (void *stack, size_t page_cnt);
+
+/* Sets up the stack region.  Must be called after paging_init()
+   and malloc_init(), and before the first thread_create(). */
+void
+kstack_init (void) {
+	ASSERT (PML4 (KSTACK_BASE) == PML4 (KERN_BASE));
+	ASSERT (PML4 (KSTACK_BASE + (uint64_t) KSTACK_SLOTS * SLOT_SIZE - 1)
+			== PML4 (KERN_BASE));
+
+	used_slots = bitmap_create (KSTACK_SLOTS);
+	if (used_slots == NULL)
+		PANIC ("kstack_init: out of memory");
+	lock_init (&map_lock);
+	lock_set_name (&map_lock, "kstack");
+}
+
+/* Returns the stack in slot SLOT. */
+static void *
+slot_to_stack (size_t slot) {
+	return (void *) (KSTACK_BASE + slot * SLOT_SIZE + PGSIZE);
+}
+
+/* Returns the slot that holds STACK. */
+static size_t
+stack_to_slot (const void *stack) {
+	return ((uint64_t) stack - KSTACK_BASE) / SLOT_SIZE;
+}
+
+/* Maps fresh pages for STACK.  Returns false if out of memory,
+   leaving none mapped. */
+static bool
+map_stack (void *stack) {
+	size_t i;
+
+	lock_acquire (&map_lock);
+	for (i = 0; i < KSTACK_PAGES; i++) {
+		uint64_t va = (uint64_t) stack + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (base_pml4, va, 1);
+		void *page = pte != NULL ? palloc_get_page (0) : NULL;
+
+		if (page == NULL) {
+			lock_release (&map_lock);
+			unmap_stack (stack, i);
+			return false;
+		}
+		*pte = vtop (page) | PTE_P | PTE_W | PTE_G;
+	}
+	lock_release (&map_lock);
+	return true;
+}
+
+/* Unmaps and frees the first PAGE_CNT pages of STACK.  The page
+   tables stay; another stack will reuse them. */
+static void
+unmap_stack (void *stack, size_t page_cnt) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		uint64_t va = (uint64_t) stack + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (base_pml4, va, 0);
+
+		ASSERT (pte != NULL && (*pte & PTE_P));
+		palloc_free_page (ptov (PTE_ADDR (*pte)));
+		*pte = 0;
+		invlpg (va);
+	}
+}
+
+/* Returns a new kernel stack of KSTACK_SIZE bytes, or a null
+   pointer if none is available.  The stack's contents are
+   undefined. */
+void *
+kstack_alloc (void) {
+	enum intr_level old_level;
+	void *stack = NULL;
+	size_t slot;
+
+	old_level = intr_disable ();
+	alloc_cnt++;
+	if (cache_cnt > 0) {
+		stack = cache[--cache_cnt];
+		reuse_cnt++;
+	}
+	intr_set_level (old_level);
+	if (stack != NULL)
+		return stack;
+
+	old_level = intr_disable ();
+	slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+	intr_set_level (old_level);
+	if (slot == BITMAP_ERROR)
+		return NULL;
+
+	stack = slot_to_stack (slot);
+	if (!map_stack (stack)) {
+		old_level = intr_disable ();
+		bitmap_reset (used_slots, slot);
+		intr_set_level (old_level);
+		return NULL;
+	}
+	return stack;
+}
+
+/* Frees STACK, which must not be in use.  May be called with
+   interrupts off, as the scheduler does. */
+void
+kstack_free (void *stack) {
+	enum intr_level old_level;
+
+	if (stack == NULL)
+		return;
+
+	old_level = intr_disable ();
+	if (cache_cnt < KSTACK_CACHE_MAX) {
+		cache[cache_cnt++] = stack;
+		intr_set_level (old_level);
+		return;
+	}
+	intr_set_level (old_level);
+
+	unmap_stack (stack, KSTACK_PAGES);
+	old_level = intr_disable ();
+	bitmap_reset (used_slots, stack_to_slot (stack));
+	intr_set_level (old_level);
+}
+
+/* Returns true if ADDR lies in the guard page of a stack slot. */
+bool
+kstack_is_guard (const void *addr) {
+	uint64_t a = (uint64_t) addr;
+
+	return a >= KSTACK_BASE
+		&& a < KSTACK_BASE + (uint64_t) KSTACK_SLOTS * SLOT_SIZE
+		&& (a - KSTACK_BASE) % SLOT_SIZE < PGSIZE;
+}
+
+/* Prints kernel stack statistics. */
+void
+kstack_print_stats (void) {
+	printf ("Kstack: %zu slots in use, %zu cached, "
+			"%lld allocated, %lld from the cache\n",
+			bitmap_count (used_slots, 0, KSTACK_SLOTS, true), cache_cnt,
+			alloc_cnt, reuse_cnt);
+}
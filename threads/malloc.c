@@ -5,142 +5,364 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
-/* A simple implementation of malloc().
-
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
-
-   When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
-
-/* Descriptor. */
-struct desc {
-	size_t block_size;          /* Size of each element in bytes. */
-	size_t blocks_per_arena;    /* Number of blocks in an arena. */
-	struct list free_list;      /* List of free blocks. */
-	struct lock lock;           /* Lock. */
+/* A slab allocator, with malloc() on top of it.
+
+   Objects of one size come from a "cache".  A cache carves
+   one-page "slabs" obtained from the page allocator into as many
+   objects as fit after the slab's header.  The header keeps the
+   slab's free objects on a list of object indexes, so the
+   allocator never writes into a free object; that lets a cache
+   run a constructor on each object once, when its slab is
+   created, instead of on every allocation.  A slab with free
+   objects sits on its cache's list of partial slabs.  When every
+   object of a slab is free again, the slab goes back to the page
+   allocator.
+
+   Every cache also has a "magazine" per CPU: a small stack of
+   free objects that allocation and freeing use without taking
+   the cache's lock, with interrupts turned off just long enough
+   to push or pop one pointer.  An allocation that finds the
+   magazine empty takes half a magazine's worth of objects from
+   the slabs under the lock, and a free that finds it full
+   returns half of it, so objects that are freed and allocated
+   again in turn rarely reach the slabs.
+
+   malloc() serves each request from the smallest of a set of
+   caches whose sizes are not all powers of 2, so a request just
+   above a power of 2 wastes at most about a third of its block
+   rather than half.  The biggest sizes are chosen so that 3 and
+   2 objects exactly fill a slab.  Requests bigger than that get
+   contiguous pages from the page allocator, with the allocation
+   size in a header at the start of the first page. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x9a548eed
+
+/* Marks the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Objects are at least this aligned. */
+#define OBJ_ALIGN 8
+
+/* Slab header, at the start of its page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache, null for big block. */
+	size_t free_cnt;            /* Free objects; pages in big block. */
+	struct list_elem elem;      /* Element in the partial slab list. */
+	uint16_t free_head;         /* First free object, or SLAB_END. */
+	uint16_t next[];            /* Next free object after each one. */
 };
 
-/* Magic number for detecting arena corruption. */
-#define ARENA_MAGIC 0x9a548eed
-
-/* Arena. */
-struct arena {
-	unsigned magic;             /* Always set to ARENA_MAGIC. */
-	struct desc *desc;          /* Owning descriptor, null for big block. */
-	size_t free_cnt;            /* Free blocks; pages in big block. */
+/* Caches used by malloc(), smallest first. */
+static const size_t malloc_sizes[] = {
+	16, 24, 32, 48, 64, 96, 128, 160, 192, 256, 320, 384, 512, 640,
+	768, 1024,
 };
+#define MALLOC_CACHE_CNT (sizeof malloc_sizes / sizeof *malloc_sizes + 2)
+static struct kmem_cache malloc_caches[MALLOC_CACHE_CNT];
+static char malloc_names[MALLOC_CACHE_CNT][16];
 
-/* Free block. */
-struct block {
-	struct list_elem free_elem; /* Free list element. */
-};
+/* Largest request malloc() serves from a cache. */
+static size_t malloc_max;
+
+/* The cache for each request size, indexed by the size divided by
+   OBJ_ALIGN and rounded up. */
+static uint8_t size_to_cache[PGSIZE / OBJ_ALIGN];
 
-/* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
-static size_t desc_cnt;         /* Number of descriptors. */
+/* Pages in big blocks, for statistics. */
+static size_t big_page_cnt;
 
-static struct arena *block_to_arena (struct block *);
-static struct block *arena_to_block (struct arena *, size_t idx);
+/* All caches, for statistics. */
+static struct list all_caches;
 
-/* Initializes the malloc() descriptors. */
+static struct slab *obj_to_slab (void *);
+static void *slab_to_obj (struct kmem_cache *, struct slab *, size_t idx);
+static size_t slab_capacity (size_t obj_size);
+
+/* Initializes the malloc() caches. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	size_t i, cnt = 0;
+
+	list_init (&all_caches);
+	for (i = 0; i < sizeof malloc_sizes / sizeof *malloc_sizes; i++)
+		malloc_caches[cnt++].obj_size = malloc_sizes[i];
+
+	/* The largest sizes that fit 3 and 2 times into a slab. */
+	for (i = 3; i >= 2; i--) {
+		size_t size = ROUND_DOWN ((PGSIZE - sizeof (struct slab)) / i,
+				OBJ_ALIGN);
+		while (slab_capacity (size) < i)
+			size -= OBJ_ALIGN;
+		malloc_caches[cnt++].obj_size = size;
+	}
+	ASSERT (cnt == MALLOC_CACHE_CNT);
+
+	for (i = 0; i < MALLOC_CACHE_CNT; i++) {
+		struct kmem_cache *c = &malloc_caches[i];
+		size_t size;
+
+		snprintf (malloc_names[i], sizeof malloc_names[i], "malloc-%zu",
+				c->obj_size);
+		kmem_cache_init (c, malloc_names[i], c->obj_size, NULL);
+		lock_set_name (&c->lock, malloc_names[i]);
+		for (size = malloc_max + 1; size <= c->obj_size; size++)
+			size_to_cache[DIV_ROUND_UP (size, OBJ_ALIGN)] = i;
+		malloc_max = c->obj_size;
 	}
 }
 
-/* Obtains and returns a new block of at least SIZE bytes.
-   Returns a null pointer if memory is not available. */
-void *
-malloc (size_t size) {
-	struct desc *d;
-	struct block *b;
-	struct arena *a;
+/* Returns the number of SIZE-byte objects that fit into a slab. */
+static size_t
+slab_capacity (size_t obj_size) {
+	size_t cnt = (PGSIZE - sizeof (struct slab)) / obj_size;
 
-	/* A null pointer satisfies a request for 0 bytes. */
-	if (size == 0)
-		return NULL;
+	while (ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t), OBJ_ALIGN)
+			+ cnt * obj_size > PGSIZE)
+		cnt--;
+	return cnt;
+}
 
-	/* Find the smallest descriptor that satisfies a SIZE-byte
-	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
-		/* SIZE is too big for any descriptor.
-		   Allocate enough pages to hold SIZE plus an arena. */
-		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
-		if (a == NULL)
-			return NULL;
-
-		/* Initialize the arena to indicate a big block of PAGE_CNT
-		   pages, and return it. */
-		a->magic = ARENA_MAGIC;
-		a->desc = NULL;
-		a->free_cnt = page_cnt;
-		return a + 1;
+/* Initializes cache C for objects of SIZE bytes, named NAME.  If
+   CTOR is non-null, it is called on each object before the object
+   is first allocated. */
+void
+kmem_cache_init (struct kmem_cache *c, const char *name, size_t size,
+		kmem_ctor_func *ctor) {
+	ASSERT (size > 0);
+
+	c->name = name;
+	c->obj_size = ROUND_UP (size, OBJ_ALIGN);
+	c->objs_per_slab = slab_capacity (c->obj_size);
+	c->obj_ofs = ROUND_UP (sizeof (struct slab)
+			+ c->objs_per_slab * sizeof (uint16_t), OBJ_ALIGN);
+	c->ctor = ctor;
+	ASSERT (c->objs_per_slab > 0 && c->objs_per_slab < SLAB_END);
+
+	lock_init (&c->lock);
+	list_init (&c->partial_slabs);
+	c->slab_cnt = 0;
+	c->obj_cnt = 0;
+	c->mag.cnt = 0;
+	c->alloc_cnt = 0;
+	c->req_bytes = 0;
+	list_push_back (&all_caches, &c->elem);
+}
+
+/* Allocates a new slab for C and puts it on C's partial list.
+   Returns false if no page is available. */
+static bool
+slab_grow (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return false;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+		if (c->ctor != NULL)
+			c->ctor (slab_to_obj (c, s, i));
 	}
+	s->free_head = 0;
+	list_push_front (&c->partial_slabs, &s->elem);
+	c->slab_cnt++;
+	return true;
+}
+
+/* Takes up to CNT objects from C's slabs into OBJS, growing C if it
+   has no free object.  Returns the number taken, which is 0 only
+   if memory is exhausted.  C's lock must be held. */
+static size_t
+slab_take (struct kmem_cache *c, void **objs, size_t cnt) {
+	size_t taken = 0;
 
-	lock_acquire (&d->lock);
+	ASSERT (lock_held_by_current_thread (&c->lock));
 
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
+	while (taken < cnt) {
+		struct slab *s;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
+		if (list_empty (&c->partial_slabs)
+				&& (taken > 0 || !slab_grow (c)))
+			break;
+
+		s = list_entry (list_front (&c->partial_slabs), struct slab, elem);
+		while (taken < cnt && s->free_head != SLAB_END) {
+			objs[taken++] = slab_to_obj (c, s, s->free_head);
+			s->free_head = s->next[s->free_head];
+			s->free_cnt--;
 		}
+		if (s->free_cnt == 0)
+			list_remove (&s->elem);
+	}
+	c->obj_cnt += taken;
+	return taken;
+}
 
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
+/* Returns the CNT objects in OBJS to their slabs in C, freeing
+   slabs that become entirely free.  C's lock must be held. */
+static void
+slab_put (struct kmem_cache *c, void **objs, size_t cnt) {
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&c->lock));
+
+	for (i = 0; i < cnt; i++) {
+		struct slab *s = obj_to_slab (objs[i]);
+		size_t idx = ((uint8_t *) objs[i] - ((uint8_t *) s + c->obj_ofs))
+			/ c->obj_size;
+
+		ASSERT (s->cache == c);
+		if (s->free_cnt++ == 0)
+			list_push_front (&c->partial_slabs, &s->elem);
+		s->next[idx] = s->free_head;
+		s->free_head = idx;
+
+		if (s->free_cnt == c->objs_per_slab) {
+			list_remove (&s->elem);
+			s->magic = 0;
+			palloc_free_page (s);
+			c->slab_cnt--;
 		}
 	}
+	c->obj_cnt -= cnt;
+}
+
+/* Allocates an object from C, as kmem_cache_alloc() does, and
+   counts REQ_BYTES as requested. */
+static void *
+cache_alloc (struct kmem_cache *c, size_t req_bytes) {
+	void *batch[KMEM_MAG_BATCH];
+	struct kmem_magazine *mag = &c->mag;
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	c->alloc_cnt++;
+	c->req_bytes += req_bytes;
+	if (mag->cnt > 0) {
+		void *obj = mag->objs[--mag->cnt];
+		intr_set_level (old_level);
+		return obj;
+	}
+	intr_set_level (old_level);
+
+	/* The magazine is empty.  Refill it from the slabs. */
+	lock_acquire (&c->lock);
+	cnt = slab_take (c, batch, KMEM_MAG_BATCH);
+	lock_release (&c->lock);
+	if (cnt == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	while (cnt > 1 && mag->cnt < KMEM_MAG_SIZE)
+		mag->objs[mag->cnt++] = batch[--cnt];
+	intr_set_level (old_level);
+
+	/* Another thread refilled the magazine while we were away. */
+	if (cnt > 1) {
+		lock_acquire (&c->lock);
+		slab_put (c, batch + 1, cnt - 1);
+		lock_release (&c->lock);
+	}
+	return batch[0];
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	return cache_alloc (c, c->obj_size);
+}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
-	return b;
+/* Like kmem_cache_alloc(), but the object is zeroed.  Only for
+   caches without a constructor. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) {
+	void *obj;
+
+	ASSERT (c->ctor == NULL);
+	obj = kmem_cache_alloc (c);
+	if (obj != NULL)
+		memset (obj, 0, c->obj_size);
+	return obj;
+}
+
+/* Returns object OBJ, which must have been allocated from cache C,
+   to C.  OBJ may be null. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	void *batch[KMEM_MAG_BATCH];
+	struct kmem_magazine *mag = &c->mag;
+	enum intr_level old_level;
+	size_t cnt;
+
+	if (obj == NULL)
+		return;
+	ASSERT (obj_to_slab (obj)->cache == c);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   it must keep its constructed state. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	old_level = intr_disable ();
+	if (mag->cnt < KMEM_MAG_SIZE) {
+		mag->objs[mag->cnt++] = obj;
+		intr_set_level (old_level);
+		return;
+	}
+
+	/* The magazine is full.  Return half of it to the slabs. */
+	for (cnt = 0; cnt < KMEM_MAG_BATCH - 1; cnt++)
+		batch[cnt] = mag->objs[--mag->cnt];
+	intr_set_level (old_level);
+	batch[cnt++] = obj;
+
+	lock_acquire (&c->lock);
+	slab_put (c, batch, cnt);
+	lock_release (&c->lock);
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	struct slab *s;
+
+	/* A null pointer satisfies a request for 0 bytes. */
+	if (size == 0)
+		return NULL;
+
+	if (size <= malloc_max)
+		return cache_alloc (&malloc_caches[size_to_cache[
+				DIV_ROUND_UP (size, OBJ_ALIGN)]], size);
+
+	/* SIZE is too big for any cache.
+	   Allocate enough pages to hold SIZE plus a slab header. */
+	size_t page_cnt = DIV_ROUND_UP (size + sizeof *s, PGSIZE);
+	s = palloc_get_multiple (0, page_cnt);
+	if (s == NULL)
+		return NULL;
+
+	/* Initialize the header to indicate a big block of PAGE_CNT
+	   pages, and return it. */
+	s->magic = SLAB_MAGIC;
+	s->cache = NULL;
+	s->free_cnt = page_cnt;
+	big_page_cnt += page_cnt;
+	return s + 1;
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -166,11 +388,10 @@ calloc (size_t a, size_t b) {
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) {
-	struct block *b = block;
-	struct arena *a = block_to_arena (b);
-	struct desc *d = a->desc;
+	struct slab *s = obj_to_slab (block);
+	struct kmem_cache *c = s->cache;
 
-	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+	return c != NULL ? c->obj_size : PGSIZE * s->free_cnt - pg_ofs (block);
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -201,68 +422,78 @@ realloc (void *old_block, size_t new_size) {
 void
 free (void *p) {
 	if (p != NULL) {
-		struct block *b = p;
-		struct arena *a = block_to_arena (b);
-		struct desc *d = a->desc;
-
-		if (d != NULL) {
-			/* It's a normal block.  We handle it here. */
-
-#ifndef NDEBUG
-			/* Clear the block to help detect use-after-free bugs. */
-			memset (b, 0xcc, d->block_size);
-#endif
-
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
+		struct slab *s = obj_to_slab (p);
 
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
-			}
-
-			lock_release (&d->lock);
+		if (s->cache != NULL) {
+			/* It's a normal block. */
+			kmem_cache_free (s->cache, p);
 		} else {
 			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
-			return;
+			big_page_cnt -= s->free_cnt;
+			palloc_free_multiple (s, s->free_cnt);
+		}
+	}
+}
+
+/* Prints a fragmentation report: for each cache in use, how much
+   of its slabs holds live objects, and how much malloc() lost to
+   rounding requests up to its sizes. */
+void
+malloc_print_stats (void) {
+	unsigned long long req_bytes = 0, alloc_bytes = 0;
+	size_t slab_pages = 0, live_bytes = 0;
+	struct list_elem *e;
+
+	printf ("Slab: %-12s %6s %6s %6s %6s %5s\n",
+			"cache", "size", "live", "cached", "slabs", "used");
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t live = c->obj_cnt - c->mag.cnt;
+
+		if (c >= malloc_caches && c < malloc_caches + MALLOC_CACHE_CNT) {
+			req_bytes += c->req_bytes;
+			alloc_bytes += c->alloc_cnt * c->obj_size;
 		}
+		if (c->slab_cnt == 0)
+			continue;
+		printf ("Slab: %-12s %6zu %6zu %6zu %6zu %4zu%%\n",
+				c->name, c->obj_size, live, c->mag.cnt, c->slab_cnt,
+				live * c->obj_size * 100 / (c->slab_cnt * PGSIZE));
+		slab_pages += c->slab_cnt;
+		live_bytes += live * c->obj_size;
 	}
+	printf ("Slab: %zu slab pages, %zu%% holding live objects; "
+			"%zu pages in big blocks\n",
+			slab_pages, slab_pages ? live_bytes * 100 / (slab_pages * PGSIZE) : 0,
+			big_page_cnt);
+	if (alloc_bytes > 0)
+		printf ("Slab: malloc rounding wasted %llu%% of %llu bytes\n",
+				(alloc_bytes - req_bytes) * 100 / alloc_bytes, alloc_bytes);
 }
-
-/* Returns the arena that block B is inside. */
-static struct arena *
-block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
-
-	/* Check that the arena is valid. */
-	ASSERT (a != NULL);
-	ASSERT (a->magic == ARENA_MAGIC);
-
-	/* Check that the block is properly aligned for the arena. */
-	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
-	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
-
-	return a;
+
+/* Returns the slab that object OBJ is inside. */
+static struct slab *
+obj_to_slab (void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid. */
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT (s->cache == NULL
+			|| (pg_ofs (obj) - s->cache->obj_ofs) % s->cache->obj_size == 0);
+	ASSERT (s->cache != NULL || pg_ofs (obj) == sizeof *s);
+
+	return s;
 }
 
-/* Returns the (IDX - 1)'th block within arena A. */
-static struct block *
-arena_to_block (struct arena *a, size_t idx) {
-	ASSERT (a != NULL);
-	ASSERT (a->magic == ARENA_MAGIC);
-	ASSERT (idx < a->desc->blocks_per_arena);
-	return (struct block *) ((uint8_t *) a
-			+ sizeof *a
-			+ idx * a->desc->block_size);
+/* Returns the IDX'th object within slab S of cache C. */
+static void *
+slab_to_obj (struct kmem_cache *c, struct slab *s, size_t idx) {
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (idx < c->objs_per_slab);
+	return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
 }
@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
@@ -8,10 +9,61 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers (PCIDs).
+ *
+ * Once CR4.PCIDE is set, the low 12 bits of CR3 hold a PCID and
+ * every TLB entry is tagged with the PCID it was loaded under, so
+ * loading CR3 need not flush the TLB: setting CR3_NOFLUSH in the
+ * new value keeps the entries of every PCID, and those of the new
+ * address space stay usable as long as its page tables have not
+ * changed behind them.  Kernel mappings are global (PTE_G) and
+ * survive CR3 loads with or without PCIDs.
+ *
+ * PCID 0 belongs to base_pml4, which has only global mappings.
+ * PCIDs 1...PCID_SLOTS are handed out to user address spaces on
+ * activation.  Each use stamps a slot with the CPU's generation,
+ * which counts activations; when every slot is taken, the one
+ * with the oldest generation is recycled, and its new owner starts
+ * out with a flush.  Pintos runs on one CPU, so there is a single
+ * allocator, but nothing in it is shared between CPUs. */
+#define PCID_SLOTS 32
+#define CR3_PCID_MASK 0xfffUL
+#define CR3_NOFLUSH (1UL << 63)
+#define CR4_PGE (1UL << 7)
+#define CR4_PCIDE (1UL << 17)
+#define CPUID_1_EDX_PGE (1U << 13)
+#define CPUID_1_ECX_PCID (1U << 17)
+
+struct pcid_slot {
+	uint64_t *pml4;         /* Owner, or a null pointer if free. */
+	uint64_t gen;           /* Generation of the owner's last use. */
+};
+
+struct pcid_cpu {
+	struct pcid_slot slots[PCID_SLOTS];
+	uint64_t gen;           /* Activations so far. */
+};
+
+static struct pcid_cpu pcid_cpu;
+static bool pcid_enabled;
+
+/* Address space switches. */
+static long long cr3_skip_cnt;          /* Same pml4 as before. */
+static long long cr3_keep_cnt;          /* Switched, TLB kept. */
+static long long cr3_flush_cnt;         /* Switched, TLB flushed. */
+
+static void pcid_forget (uint64_t *pml4);
+static void tlb_flush_page (uint64_t *pml4, uint64_t va);
+
+/* Returns the entry for VA in page directory PDP, which is the page
+ * directory entry itself if WANT_PDE is true or if it maps a large
+ * page, and otherwise the PTE in the page table below. */
 static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
+pgdir_walk (uint64_t *pdp, const uint64_t va, int create, bool want_pde) {
 	int idx = PDX (va);
 	if (pdp) {
+		if (want_pde || (pdp[idx] & PTE_PS))
+			return &pdp[idx];
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
@@ -29,7 +81,7 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 }
 
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
+pdpe_walk (uint64_t *pdpe, const uint64_t va, int create, bool want_pde) {
 	uint64_t *pte = NULL;
 	int idx = PDPE (va);
 	int allocated = 0;
@@ -46,7 +98,7 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
+		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create, want_pde);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
@@ -55,14 +107,8 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	return pte;
 }
 
-/* Returns the address of the page table entry for virtual
- * address VADDR in page map level 4, pml4.
- * If PML4E does not have a page table for VADDR, behavior depends
- * on CREATE.  If CREATE is true, then a new page table is
- * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
-uint64_t *
-pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+static uint64_t *
+pml4_walk (uint64_t *pml4e, const uint64_t va, int create, bool want_pde) {
 	uint64_t *pte = NULL;
 	int idx = PML4 (va);
 	int allocated = 0;
@@ -79,7 +125,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
+		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create, want_pde);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
@@ -88,6 +134,59 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page table entry for virtual
+ * address VADDR in page map level 4, pml4.
+ * If PML4E does not have a page table for VADDR, behavior depends
+ * on CREATE.  If CREATE is true, then a new page table is
+ * created and a pointer into it is returned.  Otherwise, a null
+ * pointer is returned.
+ * If VADDR lies in a large page, returns its page directory entry,
+ * which has PTE_PS set. */
+uint64_t *
+pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+	return pml4_walk (pml4e, va, create, false);
+}
+
+/* Like pml4e_walk(), but returns the page directory entry for
+ * VADDR, for installing a large page. */
+uint64_t *
+pml4e_walk_pde (uint64_t *pml4e, const uint64_t va, int create) {
+	return pml4_walk (pml4e, va, create, true);
+}
+
+/* Replaces the large page mapped by page directory entry PDE, which
+ * covers VA, by a page table of 4 kB PTEs with the same frames and
+ * flags, so that one of them can be changed alone.  Returns false if
+ * no memory is left for the page table. */
+static bool
+split_large_page (uint64_t *pml4, uint64_t *pde, uint64_t va) {
+	uint64_t *pt = palloc_get_page (0);
+
+	if (pt == NULL)
+		return false;
+	for (unsigned i = 0; i < LGPG_CNT; i++)
+		pt[i] = (LGPTE_ADDR (*pde) + i * PGSIZE)
+			| (*pde & PTE_FLAGS & ~PTE_PS);
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	tlb_flush_page (pml4, va & ~(LGPGSIZE - 1));
+	return true;
+}
+
+/* Returns the 4 kB PTE for UPAGE in PML4, splitting the large page
+ * that covers UPAGE if there is one.  Returns a null pointer if
+ * UPAGE has no PTE and CREATE is false, or if memory runs out. */
+static uint64_t *
+pml4_walk_small (uint64_t *pml4, const void *upage, int create) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, create);
+
+	if (pte != NULL && (*pte & PTE_PS)) {
+		if (!split_large_page (pml4, pte, (uint64_t) upage))
+			return NULL;
+		pte = pml4e_walk (pml4, (uint64_t) upage, create);
+	}
+	return pte;
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,10 +221,18 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+		if (((uint64_t) pte) & PTE_P) {
+			if (pdp[i] & PTE_PS) {
+				/* A large page is visited once, through its PDE. */
+				void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+									 ((uint64_t) pdp_index << PDPESHIFT) |
+									 ((uint64_t) i << PDXSHIFT));
+				if (!func (&pdp[i], va, aux))
+					return false;
+			} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
+		}
 	}
 	return true;
 }
@@ -143,7 +250,9 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A large page is passed as its page directory entry, which has
+ * PTE_PS set, with VA its first address. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,8 +278,12 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+		if (((uint64_t) pte) & PTE_P) {
+			if (pdp[i] & PTE_PS)
+				palloc_free_multiple ((void *) LGPTE_ADDR (pte), LGPG_CNT);
+			else
+				pt_destroy (PTE_ADDR (pte));
+		}
 	}
 	palloc_free_page ((void *) pdp);
 }
@@ -192,6 +305,10 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
+	/* Its page may come back as another pml4, which must not
+	 * inherit its TLB entries. */
+	pcid_forget (pml4);
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
@@ -199,11 +316,122 @@ pml4_destroy (uint64_t *pml4) {
 	palloc_free_page ((void *) pml4);
 }
 
+/* Enables global pages and, where the CPU has them, PCIDs.
+ * Called once base_pml4 is active. */
+void
+tlb_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_1_EDX_PGE)
+		lcr4 (rcr4 () | CR4_PGE);
+	/* Requires CR3 to name PCID 0, which base_pml4 has. */
+	if (ecx & CPUID_1_ECX_PCID) {
+		ASSERT ((rcr3 () & CR3_PCID_MASK) == 0);
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
+/* Returns true if PML4 is the CPU's current page map. */
+static bool
+pml4_is_active (uint64_t *pml4) {
+	return (rcr3 () & ~CR3_PCID_MASK) == vtop (pml4);
+}
+
+/* Returns the PCID for user page map PML4, allocating one if it
+ * has none.  Sets *FRESH to true if the PCID was not PML4's before,
+ * in which case its TLB entries may belong to another address
+ * space. */
+static uint64_t
+pcid_get (uint64_t *pml4, bool *fresh) {
+	struct pcid_cpu *cpu = &pcid_cpu;
+	struct pcid_slot *victim = &cpu->slots[0];
+
+	cpu->gen++;
+	for (int i = 0; i < PCID_SLOTS; i++) {
+		struct pcid_slot *slot = &cpu->slots[i];
+		if (slot->pml4 == pml4) {
+			slot->gen = cpu->gen;
+			*fresh = false;
+			return i + 1;
+		}
+		if (slot->gen < victim->gen)
+			victim = slot;
+	}
+
+	/* Free slots have generation 0, so they go first. */
+	victim->pml4 = pml4;
+	victim->gen = cpu->gen;
+	*fresh = true;
+	return victim - cpu->slots + 1;
+}
+
+/* Takes away the PCID of PML4, if it has one, so that its next
+ * activation flushes the TLB. */
+static void
+pcid_forget (uint64_t *pml4) {
+	for (int i = 0; i < PCID_SLOTS; i++) {
+		struct pcid_slot *slot = &pcid_cpu.slots[i];
+		if (slot->pml4 == pml4) {
+			slot->pml4 = NULL;
+			slot->gen = 0;
+		}
+	}
+}
+
+/* Drops any TLB entry for VA in PML4 after its PTE changed.  The
+ * current address space is flushed with invlpg; any other loses its
+ * PCID instead, since its entries cannot be reached from here. */
+static void
+tlb_flush_page (uint64_t *pml4, uint64_t va) {
+	if (pml4_is_active (pml4))
+		invlpg (va);
+	else if (pcid_enabled)
+		pcid_forget (pml4);
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  Nothing is done if PD is already loaded, as when
+ * switching between threads of one process or between kernel
+ * threads. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	uint64_t cr3;
+	bool fresh = false;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (pml4_is_active (pml4)) {
+		cr3_skip_cnt++;
+		return;
+	}
+
+	cr3 = vtop (pml4);
+	if (pcid_enabled) {
+		/* base_pml4 has only global mappings, so PCID 0 never
+		 * holds anything stale. */
+		if (pml4 != base_pml4)
+			cr3 |= pcid_get (pml4, &fresh);
+		if (!fresh)
+			cr3 |= CR3_NOFLUSH;
+	} else
+		fresh = true;
+
+	if (fresh)
+		cr3_flush_cnt++;
+	else
+		cr3_keep_cnt++;
+	lcr3 (cr3);
+}
+
+/* Prints address space switch statistics. */
+void
+pml4_print_stats (void) {
+	printf ("MMU: %lld address space switches skipped, "
+			"%lld with TLB kept, %lld with TLB flushed%s\n",
+			cr3_skip_cnt, cr3_keep_cnt, cr3_flush_cnt,
+			pcid_enabled ? "" : " (no PCID)");
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -216,8 +444,12 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
-	if (pte && (*pte & PTE_P))
+	if (pte && (*pte & PTE_P)) {
+		if (*pte & PTE_PS)
+			return ptov (LGPTE_ADDR (*pte))
+				+ ((uint64_t) uaddr & (LGPGSIZE - 1));
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+	}
 	return NULL;
 }
 
@@ -236,36 +468,80 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	ASSERT (is_user_vaddr (upage));
 	ASSERT (pml4 != base_pml4);
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
+	uint64_t *pte = pml4_walk_small (pml4, upage, 1);
+
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
 
-	if (pte)
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_flush_page (pml4, (uint64_t) upage);
+	}
 	return pte != NULL;
 }
 
+/* Adds a mapping in PML4 from the 2 MB user virtual region at
+ * UPAGE to the 2 MB of physically contiguous memory at kernel
+ * virtual address KPAGE, using a single large page.  Both must be
+ * 2 MB aligned, and no part of the region may be mapped already.
+ * If WRITABLE is true, the new page is read/write; otherwise it is
+ * read-only.  Returns true if successful, false if memory
+ * allocation failed or the region is in use. */
+bool
+pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT ((uint64_t) upage % LGPGSIZE == 0);
+	ASSERT ((uint64_t) kpage % LGPGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4e_walk_pde (pml4, (uint64_t) upage, 1);
+
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		/* Only an empty page table may be replaced. */
+		uint64_t *pt;
+
+		if (*pde & PTE_PS)
+			return false;
+		pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < LGPG_CNT; i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page (pt);
+	}
+	*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	tlb_flush_page (pml4, (uint64_t) upage);
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * UPAGE need not be mapped.  A large page covering UPAGE is split
+ * first, or, if no memory is left for that, cleared as a whole. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	pte = pml4_walk_small (pml4, upage, false);
+	if (pte == NULL)
+		pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_flush_page (pml4, (uint64_t) upage);
 	}
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
- * Returns false if PML4 contains no PTE for VPAGE. */
+ * Returns false if PML4 contains no PTE for VPAGE.
+ * Within a large page, this and the other accessors below act on
+ * the large page as a whole. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -283,8 +559,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -309,7 +584,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, (uint64_t) vpage);
 	}
 }
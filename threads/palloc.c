@@ -2,12 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,22 +28,80 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
-/* A memory pool. */
+/* Largest block order, 64 MB. */
+#define MAX_ORDER 14
+
+/* Zeroed pages the idle thread keeps in each pool. */
+#define ZERO_RESERVE 64
+
+/* Pages in a per-CPU page cache, and pages moved at once between
+   it and the buddy allocator. */
+#define PCP_SIZE 32
+#define PCP_BATCH (PCP_SIZE / 2)
+
+/* A CPU's cache of free single pages. */
+struct pcp_cache {
+	size_t cnt;                     /* Pages in PAGES. */
+	void *pages[PCP_SIZE];
+};
+
+/* A memory pool.
+
+   Free pages are kept by a binary buddy allocator.  A free block
+   of order K is 2**K pages long and starts at a physical page
+   number that is a multiple of 2**K, so blocks of order 9 are
+   also aligned for large pages.  Each free block sits on the
+   free list for its order, linked through its first page, and
+   ORDERS records the order of the block that starts at each
+   free page.  Allocation splits the smallest big enough block,
+   and freeing merges a block with its buddy, the other half of
+   the block of the next order, for as long as the buddy is free
+   too; both take O(log n) steps.  A request that is not a power
+   of 2 pages takes the next power of 2 and frees the tail at
+   once, so any range of pages can be freed, not just what one
+   call allocated.
+
+   Single pages come from a per-CPU cache of free pages first,
+   which is used with interrupts off instead of the pool's lock.
+   The cache trades pages with the buddy allocator in batches.
+
+   The idle thread keeps up to ZERO_RESERVE free pages of each
+   pool zeroed ahead of time, and single-page PAL_ZERO requests
+   take those first.  The reserve is still free memory: any
+   request falls back on it when nothing else is left. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *orders;                /* Order of the free block at each page. */
+	struct list free_lists[MAX_ORDER + 1];  /* Free blocks by order. */
+	struct pcp_cache pcp;           /* Per-CPU page cache; Pintos has one. */
+	struct list zeroed;             /* Zeroed free pages, linked through
+	                                   their first bytes. */
+	size_t zeroed_cnt;              /* Pages in ZEROED. */
 };
 
+/* ORDERS entry of a page that does not start a free block. */
+#define ORDER_NONE UINT8_MAX
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Single-page PAL_ZERO requests served from a zeroed reserve, and
+   zeroed on the spot. */
+static long long zero_hit_cnt, zero_miss_cnt;
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Keep zeroed pages in reserve?  Without it every PAL_ZERO page is
+   zeroed on request, which benchmarks use as a baseline. */
+bool palloc_zero_reserve = true;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -189,6 +249,8 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 
 	// generate the user pool
 	init_pool(&user_pool, &free_start, region_start, end);
+	lock_set_name (&kernel_pool.lock, "kernel pool");
+	lock_set_name (&user_pool.lock, "user pool");
 
 	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
@@ -223,12 +285,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -253,37 +315,368 @@ palloc_init (void) {
 	return ext_mem.end;
 }
 
-/* Obtains and returns a group of PAGE_CNT contiguous free pages.
-   If PAL_USER is set, the pages are obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
-	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static unsigned
+order_for (size_t page_cnt) {
+	unsigned order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Returns the physical page number of page PAGE_IDX in POOL. */
+static size_t
+pool_pfn (const struct pool *pool, size_t page_idx) {
+	return vtop (pool->base) / PGSIZE + page_idx;
+}
+
+/* Returns the free list element in the first page of the block at
+   PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx) {
+	return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX in POOL on
+   its free list. */
+static void
+block_insert (struct pool *pool, size_t page_idx, unsigned order) {
+	pool->orders[page_idx] = order;
+	list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Takes the free block at PAGE_IDX in POOL off its free list. */
+static void
+block_remove (struct pool *pool, size_t page_idx) {
+	pool->orders[page_idx] = ORDER_NONE;
+	list_remove (block_elem (pool, page_idx));
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL, starting at a
+   multiple of 2**ORDER pages, which must hold them.  Returns the
+   index of the first page, or BITMAP_ERROR if no block is big
+   enough.  POOL's lock must be held. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt, unsigned order) {
+	unsigned o;
+	size_t page_idx;
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+	ASSERT (page_cnt <= ((size_t) 1 << order));
+
+	for (o = order; o <= MAX_ORDER; o++)
+		if (!list_empty (&pool->free_lists[o]))
+			break;
+	if (o > MAX_ORDER)
+		return BITMAP_ERROR;
+
+	page_idx = ((uint8_t *) list_front (&pool->free_lists[o]) - pool->base)
+		/ PGSIZE;
+	block_remove (pool, page_idx);
+
+	/* Split off the upper halves until the block has ORDER. */
+	while (o > order) {
+		o--;
+		block_insert (pool, page_idx + ((size_t) 1 << o), o);
+	}
+
+	bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, true);
+	if (page_cnt < ((size_t) 1 << order))
+		buddy_free (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+	return page_idx;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, unsigned order) {
+	size_t pool_size = bitmap_size (pool->used_map);
+
+	while (order < MAX_ORDER) {
+		/* Buddies are paired by physical page number, so that
+		   blocks are aligned whatever the pool's base. */
+		size_t buddy_idx = (pool_pfn (pool, page_idx) ^ ((size_t) 1 << order))
+			- pool_pfn (pool, 0);
+
+		if (buddy_idx >= pool_size || pool->orders[buddy_idx] != order)
+			break;
+		block_remove (pool, buddy_idx);
+		if (buddy_idx < page_idx)
+			page_idx = buddy_idx;
+		order++;
+	}
+	block_insert (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not be
+   what one allocation returned, as the largest aligned blocks that
+   cover them.  POOL's lock must be held, except during boot. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	while (page_cnt > 0) {
+		size_t pfn = pool_pfn (pool, page_idx);
+		unsigned order = 0;
+
+		while (order < MAX_ORDER
+				&& pfn % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Returns the pages in POOL's per-CPU cache to the buddy
+   allocator.  Returns true if there were any. */
+static bool
+pcp_drain (struct pool *pool) {
+	void *pages[PCP_SIZE];
+	enum intr_level old_level;
+	size_t cnt, i;
+
+	old_level = intr_disable ();
+	cnt = pool->pcp.cnt;
+	memcpy (pages, pool->pcp.pages, cnt * sizeof *pages);
+	pool->pcp.cnt = 0;
+	intr_set_level (old_level);
 
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	for (i = 0; i < cnt; i++)
+		buddy_free (pool, pg_no (pages[i]) - pg_no (pool->base), 1);
 	lock_release (&pool->lock);
-	void *pages;
+	return cnt > 0;
+}
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+/* Returns a single page from POOL, through its per-CPU cache, or a
+   null pointer if none is free. */
+static void *
+pcp_get (struct pool *pool) {
+	struct pcp_cache *pcp = &pool->pcp;
+	void *batch[PCP_BATCH];
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	if (pcp->cnt > 0) {
+		void *page = pcp->pages[--pcp->cnt];
+		intr_set_level (old_level);
+		return page;
+	}
+	intr_set_level (old_level);
+
+	/* The cache is empty.  Refill it. */
+	lock_acquire (&pool->lock);
+	for (cnt = 0; cnt < PCP_BATCH; cnt++) {
+		size_t page_idx = buddy_alloc (pool, 1, 0);
+		if (page_idx == BITMAP_ERROR)
+			break;
+		batch[cnt] = pool->base + PGSIZE * page_idx;
+	}
+	lock_release (&pool->lock);
+	if (cnt == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	while (cnt > 1 && pcp->cnt < PCP_SIZE)
+		pcp->pages[pcp->cnt++] = batch[--cnt];
+	intr_set_level (old_level);
+
+	/* Another thread refilled the cache while we were away. */
+	if (cnt > 1) {
+		lock_acquire (&pool->lock);
+		while (cnt > 1)
+			buddy_free (pool, pg_no (batch[--cnt]) - pg_no (pool->base), 1);
+		lock_release (&pool->lock);
+	}
+	return batch[0];
+}
+
+/* Returns single page PAGE to POOL, through its per-CPU cache. */
+static void
+pcp_put (struct pool *pool, void *page) {
+	struct pcp_cache *pcp = &pool->pcp;
+	void *batch[PCP_BATCH];
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	if (pcp->cnt < PCP_SIZE) {
+		pcp->pages[pcp->cnt++] = page;
+		intr_set_level (old_level);
+		return;
+	}
+
+	/* The cache is full.  Return half of it. */
+	for (cnt = 0; cnt < PCP_BATCH - 1; cnt++)
+		batch[cnt] = pcp->pages[--pcp->cnt];
+	intr_set_level (old_level);
+	batch[cnt++] = page;
+
+	lock_acquire (&pool->lock);
+	while (cnt > 0)
+		buddy_free (pool, pg_no (batch[--cnt]) - pg_no (pool->base), 1);
+	lock_release (&pool->lock);
+}
+
+/* Returns a page from POOL's zeroed reserve, or a null pointer if
+   the reserve is empty. */
+static void *
+zero_get (struct pool *pool) {
+	enum intr_level old_level;
+	struct list_elem *e = NULL;
+
+	old_level = intr_disable ();
+	if (pool->zeroed_cnt > 0) {
+		e = list_pop_front (&pool->zeroed);
+		pool->zeroed_cnt--;
+	}
+	intr_set_level (old_level);
+
+	/* The link was the only nonzero data in the page. */
+	if (e != NULL)
+		memset (e, 0, sizeof *e);
+	return e;
+}
+
+/* Returns POOL's zeroed reserve to the buddy allocator.  Returns
+   true if it held any page. */
+static bool
+zero_drain (struct pool *pool) {
+	void *page;
+	bool any = false;
+
+	while ((page = zero_get (pool)) != NULL) {
+		lock_acquire (&pool->lock);
+		buddy_free (pool, pg_no (page) - pg_no (pool->base), 1);
+		lock_release (&pool->lock);
+		any = true;
+	}
+	return any;
+}
+
+/* Zeroes a free page for the reserve of a pool that is short of
+   one.  Returns false if no pool needed one, or no page could be
+   had without waiting.
+
+   Called by the idle thread with interrupts off, which must never
+   block: the page comes from the per-CPU cache, or from the buddy
+   allocator only if the pool's lock is free. */
+bool
+palloc_idle_zero (void) {
+	struct pool *pools[] = {&kernel_pool, &user_pool};
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!palloc_zero_reserve)
+		return false;
+	for (size_t i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		void *page = NULL;
+
+		if (pool->zeroed_cnt >= ZERO_RESERVE)
+			continue;
+		if (pool->pcp.cnt > 0)
+			page = pool->pcp.pages[--pool->pcp.cnt];
+		else if (lock_try_acquire (&pool->lock)) {
+			size_t page_idx = buddy_alloc (pool, 1, 0);
+
+			lock_release (&pool->lock);
+			if (page_idx != BITMAP_ERROR)
+				page = pool->base + PGSIZE * page_idx;
+		}
+		if (page == NULL)
+			continue;
+
+		memset (page, 0, PGSIZE);
+		list_push_front (&pool->zeroed, page);
+		pool->zeroed_cnt++;
+		return true;
+	}
+	return false;
+}
+
+/* Allocates PAGE_CNT pages from POOL at a multiple of 2**ORDER
+   pages.  Returns a null pointer if no block is big enough. */
+static void *
+pool_alloc (struct pool *pool, size_t page_cnt, unsigned order) {
+	size_t page_idx;
+
+	if (order > MAX_ORDER)
+		return NULL;
+	lock_acquire (&pool->lock);
+	page_idx = buddy_alloc (pool, page_cnt, order);
+	lock_release (&pool->lock);
+	return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Allocates PAGE_CNT pages at a multiple of 2**ORDER pages, as
+   palloc_get_multiple() describes for FLAGS. */
+static void *
+pool_get (enum palloc_flags flags, size_t page_cnt, unsigned order) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = NULL;
+	bool zeroed = false;
+
+	if (page_cnt == 1 && order == 0) {
+		if (flags & PAL_ZERO) {
+			zeroed = (pages = zero_get (pool)) != NULL;
+			if (zeroed)
+				zero_hit_cnt++;
+			else
+				zero_miss_cnt++;
+		}
+		if (pages == NULL)
+			pages = pcp_get (pool);
+		if (pages == NULL)
+			zeroed = (pages = zero_get (pool)) != NULL;
+	} else {
+		pages = pool_alloc (pool, page_cnt, order);
+
+		/* Pages in the per-CPU cache or the zeroed reserve may be
+		   what it takes to complete a block. */
+		if (pages == NULL && (pcp_drain (pool) | zero_drain (pool)))
+			pages = pool_alloc (pool, page_cnt, order);
+	}
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
 	}
-
 	return pages;
 }
 
+/* Obtains and returns a group of PAGE_CNT contiguous free pages.
+   If PAL_USER is set, the pages are obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the pages are filled with zeros.  If too few pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	return pool_get (flags, page_cnt, order_for (page_cnt));
+}
+
+/* Like palloc_get_multiple(), but the group starts at a physical
+   address that is a multiple of ALIGN_CNT pages, a power of 2, as
+   a large page mapping requires. */
+void *
+palloc_get_multiple_aligned (enum palloc_flags flags, size_t page_cnt,
+		size_t align_cnt) {
+	unsigned order = order_for (page_cnt);
+
+	ASSERT (align_cnt > 0 && (align_cnt & (align_cnt - 1)) == 0);
+	if (((size_t) 1 << order) < align_cnt)
+		order = order_for (align_cnt);
+	return pool_get (flags, page_cnt, order);
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -319,7 +712,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1)
+		pcp_put (pool, pages);
+	else {
+		lock_acquire (&pool->lock);
+		buddy_free (pool, page_idx, page_cnt);
+		lock_release (&pool->lock);
+	}
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +727,13 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("Palloc: %lld zeroed pages from the reserve, %lld zeroed "
+			"on request\n", zero_hit_cnt, zero_miss_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -336,15 +742,23 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t order_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->orders = *bm_base + bm_pages;
+	for (unsigned i = 0; i <= MAX_ORDER; i++)
+		list_init (&p->free_lists[i]);
+	p->pcp.cnt = 0;
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->orders, ORDER_NONE, pgcnt);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + order_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,56 @@
+#include "threads/pollq.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* Initializes Q as an empty queue. */
+void
+poll_queue_init (struct poll_queue *q) {
+	list_init (&q->waiters);
+}
+
+/* Initializes W, which is on no queue, to call WAKE on events. */
+void
+poll_waiter_init (struct poll_waiter *w, poll_wake_func *wake) {
+	w->queue = NULL;
+	w->wake = wake;
+}
+
+/* Adds W, which must be on no queue, to Q. */
+void
+poll_queue_add (struct poll_queue *q, struct poll_waiter *w) {
+	enum intr_level old_level = intr_disable ();
+
+	ASSERT (w->queue == NULL);
+	list_push_back (&q->waiters, &w->elem);
+	w->queue = q;
+	intr_set_level (old_level);
+}
+
+/* Removes W from its queue, if it is on one.  Once this returns,
+   W's function will not be called again. */
+void
+poll_queue_remove (struct poll_waiter *w) {
+	enum intr_level old_level = intr_disable ();
+
+	if (w->queue != NULL) {
+		list_remove (&w->elem);
+		w->queue = NULL;
+	}
+	intr_set_level (old_level);
+}
+
+/* Tells each waiter on Q that EVENTS occurred.  May be called
+   from an interrupt handler. */
+void
+poll_queue_wake (struct poll_queue *q, unsigned events) {
+	enum intr_level old_level = intr_disable ();
+	struct list_elem *e;
+
+	for (e = list_begin (&q->waiters); e != list_end (&q->waiters);) {
+		struct poll_waiter *w = list_entry (e, struct poll_waiter, elem);
+
+		e = list_next (e);
+		w->wake (w, events);
+	}
+	intr_set_level (old_level);
+}
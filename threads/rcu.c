@@ -0,0 +1,109 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* Read-copy update, quiescent-state based.
+
+   Readers take no lock.  A writer publishes a new version of an
+   object with rcu_assign_pointer() and must not free the old one
+   until every reader that might still see it is done: until a
+   grace period has passed.
+
+   A reader's critical section, between rcu_read_lock() and
+   rcu_read_unlock(), is neither preempted nor allowed to sleep.
+   thread_yield() only notes that the thread wants to yield, and
+   rcu_read_unlock() yields once the outermost section ends.  So a
+   context switch is a quiescent state: the thread switched away
+   from is outside any section.
+
+   With a single CPU that makes a grace period trivial.  While one
+   thread runs, no other can be inside a section, and an interrupt
+   handler's sections end before it returns.  synchronize_rcu()
+   therefore returns at once.  call_rcu() defers its callback to a
+   thread of its own, which cannot run before the caller leaves
+   its own sections and switches away. */
+
+/* Callbacks waiting to run, and a count of them.  Interrupts are
+   turned off to change the list, since call_rcu() may be called
+   from an interrupt handler. */
+static struct list callbacks;
+static struct semaphore callback_cnt;
+
+static thread_func callback_thread NO_RETURN;
+
+/* Starts the thread that runs callbacks.  Must be called after
+   thread_start(). */
+void
+rcu_init (void) {
+	list_init (&callbacks);
+	sema_init (&callback_cnt, 0);
+	if (thread_create ("rcu", PRI_DEFAULT, callback_thread, NULL)
+			== TID_ERROR)
+		PANIC ("rcu_init: cannot start callback thread");
+}
+
+/* Leaves an RCU read-side critical section, and yields the CPU if
+   the thread was asked to inside the outermost one. */
+void
+rcu_read_unlock (void) {
+	struct thread *curr = thread_current ();
+
+	barrier ();
+	ASSERT (curr->rcu_nesting > 0);
+	if (--curr->rcu_nesting == 0 && curr->rcu_yield) {
+		curr->rcu_yield = false;
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
+			thread_yield ();
+	}
+}
+
+/* Waits for a grace period: until every read-side critical
+   section that began before the call has ended.  See the comment
+   at the top of the file for why there is nothing to wait for.
+
+   The caller must not be inside a read-side critical section,
+   and may be made to sleep, so this must not be called within an
+   interrupt handler. */
+void
+synchronize_rcu (void) {
+	ASSERT (!intr_context ());
+	ASSERT (thread_current ()->rcu_nesting == 0);
+}
+
+/* Arranges for FUNC to be called with HEAD after a grace period,
+   in a kernel thread, where it may sleep.  Does not sleep, so it
+   may be called inside a read-side critical section or within an
+   interrupt handler. */
+void
+call_rcu (struct rcu_head *head, void (*func) (struct rcu_head *)) {
+	enum intr_level old_level;
+
+	ASSERT (head != NULL);
+	ASSERT (func != NULL);
+
+	head->func = func;
+	old_level = intr_disable ();
+	list_push_back (&callbacks, &head->elem);
+	intr_set_level (old_level);
+	sema_up (&callback_cnt);
+}
+
+/* Runs callbacks as they are queued.  Any callback this thread
+   finds was queued by a thread, or an interrupt handler, that
+   has since left the CPU, and so left its read-side critical
+   sections. */
+static void
+callback_thread (void *aux UNUSED) {
+	for (;;) {
+		enum intr_level old_level;
+		struct rcu_head *head;
+
+		sema_down (&callback_cnt);
+		old_level = intr_disable ();
+		head = list_entry (list_pop_front (&callbacks), struct rcu_head, elem);
+		intr_set_level (old_level);
+		head->func (head);
+	}
+}
@@ -27,10 +27,191 @@
    */
 
 #include "threads/synch.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Locks named with lock_set_name().  Initialized statically, so
+   that any init function may name its locks, whatever the order
+   they run in. */
+static struct list named_locks = {
+	{ NULL, &named_locks.tail },
+	{ &named_locks.head, NULL },
+};
+
+/* Named locks that lock_print_stats() reports. */
+#define LOCK_STATS_TOP 10
+
+/* Most times lock_acquire() looks at a running holder before
+   blocking. */
+#define LOCK_SPIN_MAX 1000
+
+/* Most holders a waiter's priority is passed along to: its lock's
+   holder, the holder of the lock that one waits for, and so on. */
+#define DONATE_DEPTH_MAX 8
+
+/* Arrivals in wait queues so far, to order equal priorities. */
+static uint64_t wait_seq;
+
+/* Returns the thread that E belongs to. */
+static struct thread *
+wait_entry (struct wait_elem *e) {
+	return (struct thread *) ((uint8_t *) e - offsetof (struct thread, wait_elem));
+}
+
+/* Returns true if A's thread should wake before B's. */
+static bool
+wakes_first (struct wait_elem *a, struct wait_elem *b) {
+	int a_pri = wait_entry (a)->priority, b_pri = wait_entry (b)->priority;
+
+	return a_pri > b_pri || (a_pri == b_pri && a->seq < b->seq);
+}
+
+/* Melds the heaps rooted at A and B, neither of which has
+   siblings or a parent, and returns the new root. */
+static struct wait_elem *
+meld (struct wait_elem *a, struct wait_elem *b) {
+	struct wait_elem *t;
+
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (wakes_first (b, a)) {
+		t = a;
+		a = b;
+		b = t;
+	}
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds the heaps in the sibling list that starts at FIRST into
+   one and returns its root: first in pairs from left to right,
+   then the pairs from right to left. */
+static struct wait_elem *
+merge_pairs (struct wait_elem *first) {
+	struct wait_elem *pairs = NULL, *root = NULL;
+
+	while (first != NULL) {
+		struct wait_elem *a = first, *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		a = meld (a, b);
+		a->next = pairs;
+		pairs = a;
+	}
+	while (pairs != NULL) {
+		struct wait_elem *p = pairs;
+
+		pairs = p->next;
+		p->next = NULL;
+		root = meld (root, p);
+	}
+	return root;
+}
+
+static void
+wait_queue_init (struct wait_queue *q) {
+	q->root = NULL;
+}
+
+static bool
+wait_queue_empty (const struct wait_queue *q) {
+	return q->root == NULL;
+}
+
+/* Adds T to Q at the arrival time already in its wait_elem. */
+static void
+wait_queue_insert (struct wait_queue *q, struct thread *t) {
+	struct wait_elem *e = &t->wait_elem;
+
+	e->child = e->next = e->prev = NULL;
+	t->wait_queue = q;
+	q->root = meld (q->root, e);
+}
+
+/* Adds the current thread to the back of its priority in Q. */
+static void
+wait_queue_push (struct wait_queue *q) {
+	struct thread *t = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->wait_queue == NULL);
+
+	t->wait_elem.seq = wait_seq++;
+	wait_queue_insert (q, t);
+}
+
+/* Takes T out of the queue it is in. */
+static void
+wait_queue_remove (struct thread *t) {
+	struct wait_queue *q = t->wait_queue;
+	struct wait_elem *e = &t->wait_elem;
+	struct wait_elem *rest = merge_pairs (e->child);
+
+	if (e == q->root)
+		q->root = rest;
+	else {
+		if (e->prev->child == e)
+			e->prev->child = e->next;
+		else
+			e->prev->next = e->next;
+		if (e->next != NULL)
+			e->next->prev = e->prev;
+		e->next = e->prev = NULL;
+		q->root = meld (q->root, rest);
+	}
+	if (q->root != NULL)
+		q->root->prev = NULL;
+	t->wait_queue = NULL;
+}
+
+/* Removes and returns the highest-priority thread in Q, which
+   must not be empty.  Among equals, the one that has waited
+   longest. */
+static struct thread *
+wait_queue_pop (struct wait_queue *q) {
+	struct thread *t;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!wait_queue_empty (q));
+
+	t = wait_entry (q->root);
+	wait_queue_remove (t);
+	return t;
+}
+
+/* Returns the highest priority in Q, which must not be empty. */
+static int
+wait_queue_max_priority (const struct wait_queue *q) {
+	return wait_entry (q->root)->priority;
+}
+
+/* Moves T to its new place in the queue it waits in, if any, after
+   its priority changed. */
+void
+wait_queue_update (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+
+	if (t->wait_queue != NULL) {
+		struct wait_queue *q = t->wait_queue;
+
+		wait_queue_remove (t);
+		wait_queue_insert (q, t);
+	}
+	intr_set_level (old_level);
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +227,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	wait_queue_init (&sema->waiters);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,7 +247,7 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
-		list_push_back (&sema->waiters, &thread_current ()->elem);
+		wait_queue_push (&sema->waiters);
 		thread_block ();
 	}
 	sema->value--;
@@ -109,11 +290,8 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)){
-		struct list_elem *temp_elem = list_max(&sema->waiters, sema_priority_cmp, NULL);
-		list_remove(temp_elem);
-		thread_unblock (list_entry(temp_elem, struct thread, elem));
-	}
+	if (!wait_queue_empty (&sema->waiters))
+		thread_unblock (wait_queue_pop (&sema->waiters));
 	sema->value++;
 	thread_preempt();
 	intr_set_level (old_level);
@@ -175,6 +353,165 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	lock->name = NULL;
+	lock->acquired_at = 0;
+	lock->acquire_cnt = 0;
+	lock->contended_cnt = 0;
+	lock->wait_cycles = 0;
+	lock->max_hold_cycles = 0;
+}
+
+/* Names LOCK and lists it in lock_print_stats().  LOCK must not
+   be freed or initialized again afterward. */
+void
+lock_set_name (struct lock *lock, const char *name) {
+	enum intr_level old_level;
+
+	ASSERT (lock != NULL);
+	ASSERT (name != NULL);
+
+	old_level = intr_disable ();
+	if (lock->name == NULL)
+		list_push_back (&named_locks, &lock->elem);
+	lock->name = name;
+	intr_set_level (old_level);
+}
+
+/* Adaptive spinning.  A holder running on another CPU is likely
+   to release LOCK sooner than it takes to block and be woken, so
+   wait for it while it keeps running, up to LOCK_SPIN_MAX times.
+   Returns true if LOCK was acquired.  With a single CPU the
+   holder cannot be running while we are, so this returns false
+   at once. */
+static bool
+spin_acquire (struct lock *lock) {
+	int i;
+
+	for (i = 0; i < LOCK_SPIN_MAX; i++) {
+		struct thread *holder = *(struct thread *volatile *) &lock->holder;
+
+		if (holder == NULL)
+			return sema_try_down (&lock->semaphore);
+		if (holder->status != THREAD_RUNNING)
+			return false;
+		asm volatile ("pause");
+	}
+	return false;
+}
+
+/* Records that the current thread acquired LOCK at NOW, after
+   waiting since START if CONTENDED. */
+static void
+note_acquired (struct lock *lock, uint64_t now, bool contended,
+		uint64_t start) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	lock->holder = curr;
+	list_push_back (&curr->held_locks, &lock->held_elem);
+	intr_set_level (old_level);
+	lock->acquired_at = now;
+	lock->acquire_cnt++;
+	if (contended) {
+		lock->contended_cnt++;
+		lock->wait_cycles += now - start;
+	}
+}
+
+/* Priority donation.
+
+   A thread waiting for a lock lends its priority to the lock's
+   holder, and through it to the holder of the lock that holder
+   waits for, and so on, so that a low-priority holder does not
+   keep a higher-priority waiter from running.  Each lock's
+   donation is just the highest priority among its waiters, the
+   root of its semaphore's wait queue, and a thread's priority is
+   the highest of its own and the donations to the locks it
+   holds.  A writer waiting for the readers of a reader-writer
+   lock to leave lends its priority to each of them the same way.
+
+   Donating only ever raises priorities, so lock_acquire() raises
+   holders along the chain and stops at the first one that is
+   already high enough, or after DONATE_DEPTH_MAX of them.
+   Releasing a lock can only lower the releaser's priority, which
+   lock_release() recomputes from the locks it still holds.  The
+   MLFQS computes priorities itself and does without donation. */
+
+/* Passes T's priority along the chain of holders that T waits
+   on, DEPTH of them at most.  A writer waiting for the readers of
+   a reader-writer lock to leave waits on every one of them, so
+   there the chain branches. */
+static void
+donate (struct thread *t, int depth) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (; depth > 0; depth--) {
+		struct thread *holder;
+
+		if (t->rwlock != NULL) {
+			struct list *holds = &t->rwlock->holds;
+			struct list_elem *e;
+
+			for (e = list_begin (holds); e != list_end (holds); e = list_next (e)) {
+				holder = list_entry (e, struct rwlock_hold, elem)->thread;
+				if (holder->priority < t->priority) {
+					holder->priority = t->priority;
+					wait_queue_update (holder);
+					donate (holder, depth - 1);
+				}
+			}
+			break;
+		}
+		if (t->lock == NULL)
+			break;
+		holder = t->lock->holder;
+		if (holder == NULL || holder->priority >= t->priority)
+			break;
+		holder->priority = t->priority;
+		wait_queue_update (holder);
+		t = holder;
+	}
+}
+
+/* Sets T's priority to the highest of its own and the donations
+   to the locks it holds, including a writer's to the reader-writer
+   locks it holds for reading. */
+void
+lock_update_priority (struct thread *t) {
+	enum intr_level old_level;
+	struct list_elem *e;
+	int priority = t->original_priority;
+	int i;
+
+	old_level = intr_disable ();
+	for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+			e = list_next (e)) {
+		struct lock *lock = list_entry (e, struct lock, held_elem);
+
+		if (!wait_queue_empty (&lock->semaphore.waiters)) {
+			int donation = wait_queue_max_priority (&lock->semaphore.waiters);
+
+			if (donation > priority)
+				priority = donation;
+		}
+	}
+	for (i = 0; i < RWLOCK_READ_MAX; i++) {
+		struct rwlock *rw = t->read_holds[i].rwlock;
+
+		if (rw != NULL && !wait_queue_empty (&rw->drained.waiters)) {
+			int donation = wait_queue_max_priority (&rw->drained.waiters);
+
+			if (donation > priority)
+				priority = donation;
+		}
+	}
+	if (priority != t->priority) {
+		t->priority = priority;
+		/* T may already be waiting on a condition variable. */
+		wait_queue_update (t);
+	}
+	intr_set_level (old_level);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -187,34 +524,42 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	uint64_t start;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	if(!thread_mlfqs){
-		//락 홀더가 이미 존재한다면 내 우선순위를 빌려줌.(nested 포함해서 앞으로 쭉 밀어줌)
-		if(lock->holder != NULL){
-			thread_current()->lock = lock;
-			list_insert_ordered(&lock->holder->donation_list, &thread_current()->donate_elem, donate_priority_cmp, NULL);
-
-			struct thread* curr = thread_current();
-			struct thread* holder;
-
-			for(int i = 0; i < 8; i++){
-				if(curr->lock == NULL) break;
-				holder = curr->lock->holder;
-				holder->priority = thread_current()->priority;
-				curr = holder;
-			}
-		}
+	if (sema_try_down (&lock->semaphore)) {
+		note_acquired (lock, rdtsc (), false, 0);
+		return;
+	}
+	start = rdtsc ();
+	if (spin_acquire (lock)) {
+		note_acquired (lock, rdtsc (), true, start);
+		return;
 	}
 
+	/* Donate and join the waiters at once, so that the holder
+	   cannot recompute its priority in between without us. */
+	old_level = intr_disable ();
+	if (!thread_mlfqs) {
+		curr->lock = lock;
+		donate (curr, DONATE_DEPTH_MAX);
+	}
 	sema_down (&lock->semaphore);
-	lock->holder = thread_current ();
-	if(!thread_mlfqs){
-		//내가 락을 홀딩했다면, lock의 도네 우선순위를 original_priority로 바꿔주고 내가 소유한 락 리스트에 락을 추가함.
-		thread_current()->lock = NULL;
+	curr->lock = NULL;
+	note_acquired (lock, rdtsc (), true, start);
+	/* Take over the donations of the threads still waiting. */
+	if (!thread_mlfqs && !wait_queue_empty (&lock->semaphore.waiters)) {
+		int donation = wait_queue_max_priority (&lock->semaphore.waiters);
+
+		if (donation > curr->priority)
+			curr->priority = donation;
 	}
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -232,7 +577,7 @@ lock_try_acquire (struct lock *lock) {
 
 	success = sema_try_down (&lock->semaphore);
 	if (success)
-		lock->holder = thread_current ();
+		note_acquired (lock, rdtsc (), false, 0);
 	return success;
 }
 
@@ -244,37 +589,25 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+	uint64_t held;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if(!thread_mlfqs){
-		// 스레드 후원 리스트에서 후원자들을 삭제해줌.
-		struct list_elem *curr = list_begin(&thread_current()->donation_list);
-		while (curr != list_end(&thread_current()->donation_list))
-		{
-			if(list_entry(curr, struct thread, donate_elem)->lock == lock){
-				curr = list_remove(curr);
-			}
-			else{
- 				curr = list_next(curr);
-			}
-		}
-		//우선순위 업데이트 해줌
-		if(list_empty(&thread_current()->donation_list)) 
-			thread_current()->priority = thread_current()->original_priority;
-		else 
-			thread_current()->priority = list_entry(list_front(&thread_current()->donation_list), struct thread, donate_elem)->priority;
-	}
+	held = rdtsc () - lock->acquired_at;
+	if (held > lock->max_hold_cycles)
+		lock->max_hold_cycles = held;
+
+	old_level = intr_disable ();
+	list_remove (&lock->held_elem);
+	if (!thread_mlfqs)
+		lock_update_priority (thread_current ());
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
-bool donate_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux){
-	struct thread *l1 = list_entry(elem1, struct thread, donate_elem);
-	struct thread *l2 = list_entry(elem1, struct thread, donate_elem);
-
-	return l1->priority > l2->priority;
-}
 /* Returns true if the current thread holds LOCK, false
    otherwise.  (Note that testing whether some other thread holds
    a lock would be racy.) */
@@ -285,11 +618,43 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
+/* Returns true if A should rank above B in lock_print_stats(). */
+static bool
+more_contended (const struct lock *a, const struct lock *b) {
+	if (a->wait_cycles != b->wait_cycles)
+		return a->wait_cycles > b->wait_cycles;
+	return a->contended_cnt > b->contended_cnt;
+}
+
+/* Prints statistics for the LOCK_STATS_TOP named locks that
+   threads spent the longest waiting for. */
+void
+lock_print_stats (void) {
+	struct lock *top[LOCK_STATS_TOP];
+	size_t top_cnt = 0, i;
+	struct list_elem *e;
+
+	for (e = list_begin (&named_locks); e != list_end (&named_locks);
+			e = list_next (e)) {
+		struct lock *lock = list_entry (e, struct lock, elem);
+
+		if (lock->acquire_cnt == 0)
+			continue;
+		if (top_cnt < LOCK_STATS_TOP)
+			top_cnt++;
+		else if (!more_contended (lock, top[top_cnt - 1]))
+			continue;
+		for (i = top_cnt - 1; i > 0 && more_contended (lock, top[i - 1]); i--)
+			top[i] = top[i - 1];
+		top[i] = lock;
+	}
+
+	for (i = 0; i < top_cnt; i++)
+		printf ("Lock: %s: %llu acquired, %llu contended, "
+				"%llu cycles waiting, %llu cycles longest hold\n",
+				top[i]->name, top[i]->acquire_cnt, top[i]->contended_cnt,
+				top[i]->wait_cycles, top[i]->max_hold_cycles);
+}
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -298,7 +663,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	wait_queue_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -323,19 +688,24 @@ cond_init (struct condition *cond) {
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	struct semaphore_elem waiter;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	list_push_back (&cond->waiters, &waiter.elem);
+	/* Releasing LOCK may yield, and a signal may come before we
+	   block, so wait only while still in the queue. */
+	old_level = intr_disable ();
+	wait_queue_push (&cond->waiters);
 	lock_release (lock);
-	sema_down (&waiter.semaphore);
+	while (curr->wait_queue != NULL)
+		thread_block ();
+	intr_set_level (old_level);
 	lock_acquire (lock);
-} 
+}
 
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
@@ -346,36 +716,27 @@ cond_wait (struct condition *cond, struct lock *lock) {
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)){
-		struct semaphore_elem *sem = list_entry(list_max(&cond->waiters, cond_priority_cmp, NULL),
-					struct semaphore_elem, elem);
-		list_remove(&sem->elem);
-		sema_up (&sem->semaphore);
-	}	
-}
-
-
-bool cond_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux)
-{
-	struct semaphore_elem *sem1 = list_entry(elem1, struct semaphore_elem, elem);
-	struct semaphore_elem *sem2 = list_entry(elem2, struct semaphore_elem, elem);
-	struct thread *t1 = list_entry(list_begin(&sem1->semaphore.waiters), struct thread, elem);
-	struct thread *t2 = list_entry(list_begin(&sem2->semaphore.waiters), struct thread, elem);
-	
-	return t1->priority < t2->priority;
+	old_level = intr_disable ();
+	if (!wait_queue_empty (&cond->waiters)) {
+		struct thread *t = wait_queue_pop (&cond->waiters);
+
+		/* A waiter still on its way to blocking need only leave
+		   the queue. */
+		if (t->status == THREAD_BLOCKED) {
+			thread_unblock (t);
+			thread_preempt ();
+		}
+	}
+	intr_set_level (old_level);
 }
 
-bool sema_priority_cmp(const struct list_elem *elem1, const struct list_elem *elem2, void *aux)
-{
-	struct thread *t1 = list_entry(elem1, struct thread, elem);
-	struct thread *t2 = list_entry(elem2, struct thread, elem);
-	return t1->priority < t2->priority;
-}
 /* Wakes up all threads, if any, waiting on COND (protected by
    LOCK).  LOCK must be held before calling this function.
 
@@ -387,6 +748,118 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!wait_queue_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes RW, held by no one.
+
+   Readers and writers alike enter through RW's lock, which wakes
+   its waiters highest priority first and in arrival order among
+   equals.  A writer keeps the lock while it waits for the readers
+   already inside to leave, so readers that arrive later queue
+   behind it: neither side can starve the other.  Each reader
+   records its hold in RW, so that the waiting writer can lend it
+   its priority just as a lock's waiter lends it to the holder. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	rw->readers = 0;
+	list_init (&rw->holds);
+	rw->draining = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.  A thread waiting here donates its priority to
+   the writer.  A thread may hold RWLOCK_READ_MAX reader-writer
+   locks for reading at once.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	for (i = 0; curr->read_holds[i].rwlock != NULL; i++)
+		ASSERT (i + 1 < RWLOCK_READ_MAX);
+	curr->read_holds[i].rwlock = rw;
+	curr->read_holds[i].thread = curr;
+	list_push_back (&rw->holds, &curr->read_holds[i].elem);
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading,
+   along with any priority a waiting writer lent it for RW.  The
+   last reader out lets in a waiting writer.  Does not take RW's
+   lock, which that writer holds. */
+void
+rwlock_read_release (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (rw != NULL);
+
+	old_level = intr_disable ();
+	for (i = 0; curr->read_holds[i].rwlock != rw; i++)
+		ASSERT (i + 1 < RWLOCK_READ_MAX);
+	curr->read_holds[i].rwlock = NULL;
+	list_remove (&curr->read_holds[i].elem);
+	ASSERT (rw->readers > 0);
+	if (!thread_mlfqs)
+		lock_update_priority (curr);
+	if (--rw->readers == 0 && rw->draining) {
+		rw->draining = false;
+		sema_up (&rw->drained);
+	} else
+		thread_preempt ();
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  While it waits for the readers inside to leave, it lends
+   each of them its priority.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	if (rw->readers > 0) {
+		/* Donate and join the waiters at once, as in lock_acquire(). */
+		rw->draining = true;
+		if (!thread_mlfqs) {
+			curr->rwlock = rw;
+			donate (curr, DONATE_DEPTH_MAX);
+		}
+		sema_down (&rw->drained);
+		curr->rwlock = NULL;
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_write_release (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (rw->readers == 0);
+
+	lock_release (&rw->lock);
+}
@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/kstack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -79,15 +80,37 @@ static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
 
+#ifdef USERPROG
+/* Control register bits for the FPU and SSE. */
+#define CR0_MP (1UL << 1)           /* Monitor coprocessor. */
+#define CR0_EM (1UL << 2)           /* Emulate the FPU. */
+#define CR4_OSFXSR (1UL << 9)       /* fxsave and SSE instructions. */
+#define CR4_OSXMMEXCPT (1UL << 10)  /* Unmasked SSE exceptions. */
+
+/* FPU and SSE state every thread starts with. */
+static uint8_t fpu_init_state[FPU_STATE_SIZE] __attribute__ ((aligned (16)));
+
+/* Thread whose state is in the FPU and SSE registers, or null.
+   Only threads that have entered user mode are given them, so
+   switches to kernel threads, and back to the thread that last
+   ran user code, leave the registers alone. */
+static struct thread *fpu_owner;
+
+static void fpu_init (void);
+static void fpu_load (struct thread *);
+#endif
+
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
 
-/* Returns the running thread.
- * Read the CPU's stack pointer `rsp', and then round that
- * down to the start of a page.  Since `struct thread' is
- * always at the beginning of a page and the stack pointer is
- * somewhere in the middle, this locates the curent thread. */
-#define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
+/* The running thread.  Kernel stacks are allocated apart from
+   `struct thread', so it cannot be found from the stack pointer.
+   thread_launch() updates it on every switch; Pintos runs on one
+   CPU, so there is one. */
+static struct thread *running;
+
+/* Returns the running thread. */
+#define running_thread() (running)
 
 
 // Global descriptor table for the thread_start.
@@ -123,14 +146,22 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
+	lock_set_name (&tid_lock, "tid");
 	list_init (&ready_list);
 	list_init (&sleep_list); //alarm-clock 리스트
 	list_init (&all_list); //all_list 초기화
 	list_init (&destruction_req);
 	ready_threads = 0; // 초기화
 	load_avg = 0; // 초기화
-	/* Set up a thread structure for the running thread. */
-	initial_thread = running_thread ();
+#ifdef USERPROG
+	fpu_init ();
+#endif
+
+	/* Set up a thread structure for the running thread.  Its
+	   stack is the rest of the page the loader gave us, with no
+	   guard page below it, so it should stay shallow. */
+	ASSERT (sizeof (struct thread) <= PGSIZE);
+	initial_thread = running = pg_round_down (rrsp ());
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
@@ -199,17 +230,25 @@ tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
 	struct thread *t;
+	void *stack;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
-	/* Allocate thread. */
+	/* Allocate thread and its stack. */
 	t = palloc_get_page (PAL_ZERO);
 	if (t == NULL)
 		return TID_ERROR;
+	stack = kstack_alloc ();
+	if (stack == NULL) {
+		palloc_free_page (t);
+		return TID_ERROR;
+	}
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
+	t->kstack = stack;
+	t->tf.rsp = (uint64_t) stack + KSTACK_SIZE - sizeof (void *);
 	tid = t->tid = allocate_tid ();
 	
 
@@ -241,6 +280,7 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (thread_current ()->rcu_nesting == 0);
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -315,7 +355,9 @@ thread_exit (void) {
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
-   may be scheduled again immediately at the scheduler's whim. */
+   may be scheduled again immediately at the scheduler's whim.
+   Inside an RCU read-side critical section, the thread yields
+   only when it leaves the section. */
 void
 thread_yield (void) {
 	struct thread *curr = thread_current ();
@@ -323,6 +365,11 @@ thread_yield (void) {
 
 	ASSERT (!intr_context ());
 
+	if (curr->rcu_nesting > 0) {
+		curr->rcu_yield = true;
+		return;
+	}
+
 	old_level = intr_disable ();
 	if (curr != idle_thread)
 		list_insert_ordered (&ready_list, &curr->elem, list_priority_cmp, NULL);
@@ -333,12 +380,10 @@ thread_yield (void) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
-
-	//기부가 존재하는 스케줄러. 기부 받지 않았을 경우에만 priority를 업데이트해줌. 오리지널은 그냥 해줌.
+	/* The thread keeps any higher priority lent to it. */
 	if(!thread_mlfqs){
-		if(thread_current()->priority == thread_current()->original_priority) 
-			thread_current ()->priority = new_priority;
 		thread_current ()->original_priority = new_priority;
+		lock_update_priority (thread_current ());
 		thread_preempt();
 	}
 }
@@ -400,6 +445,12 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* Nobody else wants to run.  Use the time to zero a page
+		   for PAL_ZERO requests, if one is wanted, and then look
+		   for other work again. */
+		if (palloc_idle_zero ())
+			continue;
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -435,30 +486,35 @@ init_thread (struct thread *t, const char *name, int priority) {
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
 	memset (t, 0, sizeof *t);
+#ifdef USERPROG
+	memcpy (t->fpu, fpu_init_state, sizeof t->fpu);
+#endif
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
 	t->original_priority = priority; //진짜 우선순위 초기화
 	t->lock = NULL; // 내가 걸려있는 락도 널로 초기화
 	t->nice = 0;
 	t->recent_cpu = 0;
-	list_init(&t->donation_list); // 내가 가지고 있는 락 리스트도 초기화
-	list_init(&t->child_list);
+	list_init (&t->held_locks);
 	list_push_back(&all_list, &t->all_elem);
 	// 업데이트
 	
-	for (int i = 0; i < maxfd; i++) {
-			t->fdt[i] = NULL;
-			t->est[i] = NULL;
-	}
+	t->proc = t;
+	t->fdt = NULL;
+	t->join_record = NULL;
+	t->stack_slot = -1;
+	t->exit_record = NULL;
+	list_init (&t->children);
+	list_init (&t->exited_children);
+	cond_init (&t->child_exited);
+	list_init (&t->join_records);
+	cond_init (&t->thread_exited);
+	t->thread_cnt = 0;
+	t->stack_slots = 0;
+	t->exiting = false;
 	t->user_exit = false;
 	t->exec_file = NULL;
-	if(is_thread(running_thread())){
-		list_push_back(&thread_current()->child_list, &t->child_elem);
-		t->parent = thread_current();
-		t->is_waited = false;	
-	}
 	t->magic = THREAD_MAGIC;
 
 
@@ -521,11 +577,18 @@ thread_launch (struct thread *th) {
 	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
 
+	/* TH counts as running from here on, although we are still on
+	   the old thread's stack until do_iret. */
+	running = th;
+
 	/* The main switching logic.
 	 * We first restore the whole execution context into the intr_frame
 	 * and then switching to the next thread by calling do_iret.
 	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
+	 * until switching is done.
+	 * The inputs are pinned to rax and rcx, which the code saves
+	 * before it overwrites them, and the labels are numeric so that
+	 * the asm may be duplicated when the optimizer inlines us. */
 	__asm __volatile (
 			/* Store registers that will be used. */
 			"push %%rax\n"
@@ -556,10 +619,10 @@ thread_launch (struct thread *th) {
 			"movw %%es, (%%rax)\n"
 			"movw %%ds, 8(%%rax)\n"
 			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
+			"call 1f\n"             // read the current rip.
+			"1:\n"
 			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
+			"addq $(2f - 1b), %%rbx\n"
 			"movq %%rbx, 0(%%rax)\n" // rip
 			"movw %%cs, 8(%%rax)\n"  // cs
 			"pushfq\n"
@@ -568,9 +631,9 @@ thread_launch (struct thread *th) {
 			"mov %%rsp, 24(%%rax)\n" // rsp
 			"movw %%ss, 32(%%rax)\n"
 			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
+			"call %P2\n"
+			"2:\n"
+			: : "a" (tf_cur), "c" (tf), "i" (do_iret) : "memory"
 			);
 }
 
@@ -585,6 +648,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
+		kstack_free (victim->kstack);
 		palloc_free_page(victim);
 	}
 	thread_current ()->status = status;
@@ -623,12 +687,73 @@ schedule (void) {
 			list_push_back (&destruction_req, &curr->elem);
 		}
 
+#ifdef USERPROG
+		if (curr == fpu_owner && curr->status == THREAD_DYING)
+			fpu_owner = NULL;
+		if (next->fpu_user)
+			fpu_load (next);
+#endif
+
 		/* Before switching the thread, we first save the information
 		 * of current running. */
 		thread_launch (next);
 	}
 }
 
+#ifdef USERPROG
+/* Lets user programs use the FPU and SSE, and records the state
+   new threads start with: every exception masked, registers
+   empty. */
+static void
+fpu_init (void) {
+	uint32_t mxcsr = 0x1f80;
+
+	lcr0 ((rcr0 () & ~CR0_EM) | CR0_MP);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	__asm __volatile ("fninit; ldmxcsr %0" : : "m" (mxcsr));
+	fxsave (fpu_init_state);
+}
+
+/* Puts T's state in the FPU and SSE registers, first saving that
+   of the thread that had them.  Interrupts must be off. */
+static void
+fpu_load (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t != fpu_owner) {
+		if (fpu_owner != NULL)
+			fxsave (fpu_owner->fpu);
+		fxrstor (t->fpu);
+		fpu_owner = t;
+	}
+}
+
+/* Gives the running thread the FPU and SSE registers, which it
+   keeps across switches from now on.  Called before it first
+   enters user mode, which it does without a switch. */
+void
+thread_fpu_acquire (void) {
+	enum intr_level old_level = intr_disable ();
+
+	thread_current ()->fpu_user = true;
+	fpu_load (thread_current ());
+	intr_set_level (old_level);
+}
+
+/* Copies the FPU and SSE state of FROM, which is not running, to
+   the running thread, for fork(). */
+void
+thread_fpu_copy (struct thread *from) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	if (from == fpu_owner)
+		fxsave (from->fpu);
+	memcpy (curr->fpu, from->fpu, sizeof curr->fpu);
+	intr_set_level (old_level);
+}
+#endif
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -667,6 +792,17 @@ void thread_sleep(int64_t time){
 	intr_set_level (old_level);
 }
 
+/* Wakes T, which is asleep in thread_sleep(), before its time.
+   Interrupts must be off. */
+void
+thread_wake_early (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_BLOCKED);
+
+	list_remove (&t->elem);
+	thread_unblock (t);
+}
+
 void thread_wake(int64_t tick){
 	struct list_elem *list_ptr= list_begin(&sleep_list);
 	struct thread *curr;
@@ -697,7 +833,7 @@ void thread_calculate_priority(struct thread *t){
 	t->priority = PRI_MAX - f_t_i(t->recent_cpu / 4) - (t->nice * 2);
 	if(t->priority > PRI_MAX) t->priority = PRI_MAX;
 	if(t->priority < PRI_MIN) t->priority = PRI_MIN;
-	
+	wait_queue_update (t);
 }
 // 모든 스레드들의 우선순위를 재계산함.(4 tick 마다)
 void calculate_priority(void){
@@ -2,16 +2,21 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/tss.h"
 #include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/thread.h"
 #include "intrinsic.h"
 #include "userprog/syscall.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void double_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -59,6 +64,13 @@ exception_init (void) {
 	   We need to disable interrupts for page faults because the
 	   fault address is stored in CR2 and needs to be preserved. */
 	intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+	/* In the kernel, a double fault most likely means a page fault
+	   on a stack's guard page, whose frame could not be pushed onto
+	   the stack that overflowed.  So it gets a stack of its own. */
+	intr_register_int (8, 0, INTR_OFF, double_fault,
+			"#DF Double Fault Exception");
+	intr_set_ist (8, TSS_IST_DOUBLE_FAULT);
 }
 
 /* Prints exception statistics. */
@@ -83,11 +95,12 @@ kill (struct intr_frame *f) {
 	switch (f->cs) {
 		case SEL_UCSEG:
 			/* User's code segment, so it's a user exception, as we
-			   expected.  Kill the user process.  */
+			   expected.  Kill the user process, with all its
+			   threads.  */
 			printf ("%s: dying due to interrupt %#04llx (%s).\n",
 					thread_name (), f->vec_no, intr_name (f->vec_no));
 			intr_dump_frame (f);
-			thread_exit ();
+			process_terminate (-1);
 
 		case SEL_KCSEG:
 			/* Kernel's code segment, which indicates a kernel bug.
@@ -141,6 +154,12 @@ page_fault (struct intr_frame *f) {
 	write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
 
+	/* A kernel stack ran into its guard page, with room left for
+	   this handler's frame. */
+	if (!user && kstack_is_guard (fault_addr))
+		PANIC ("Kernel stack overflow in thread %s at %p",
+				thread_name (), fault_addr);
+
 #ifdef VM
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
@@ -150,6 +169,11 @@ page_fault (struct intr_frame *f) {
 	/* Count page faults. */
 	page_fault_cnt++;
 
+	/* A bad pointer handed to a system call: let the accessor that
+	   tripped over it report the failure. */
+	if (!user && uaccess_fixup (f))
+		return;
+
 
 	exit(-1);
 	/* If the fault is true fault, show info and exit. */
@@ -161,3 +185,16 @@ page_fault (struct intr_frame *f) {
 	// kill (f);
 }
 
+/* Double fault handler, which runs on its own stack.  CR2 still
+   holds the address of the page fault that could not be
+   delivered, if that is what happened. */
+static void
+double_fault (struct intr_frame *f) {
+	void *fault_addr = (void *) rcr2 ();
+
+	intr_dump_frame (f);
+	if (kstack_is_guard (fault_addr))
+		PANIC ("Kernel stack overflow in thread %s at %p",
+				thread_name (), fault_addr);
+	PANIC ("Double fault");
+}
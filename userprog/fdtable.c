@@ -0,0 +1,319 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/rcu.h"
+
+/* Descriptors in a new table. */
+#define FD_INIT_CAPACITY 64
+
+/* Descriptors per word of the open bitmap. */
+#define FD_WORD_BITS 64
+
+/* Drops a table entry's reference to FILE. */
+static void
+release (struct file *file) {
+	if (!fd_is_console (file))
+		file_close (file);
+}
+
+/* Grows T to hold at least CAPACITY descriptors, which must not
+   exceed FD_MAX.  Returns false if out of memory, leaving T's
+   descriptors as they were.
+
+   fd_get() may be reading the old FILES without T's lock, so the
+   new one is a copy that replaces it, and the old one is freed
+   only after a grace period. */
+static bool
+grow (struct fd_table *t, int capacity) {
+	int new_capacity = t->capacity != 0 ? t->capacity : FD_INIT_CAPACITY;
+	int old_words = t->capacity / FD_WORD_BITS;
+	struct file **files, **old_files = t->files;
+	uint64_t *open;
+
+	ASSERT (capacity <= FD_MAX);
+	if (capacity <= t->capacity)
+		return true;
+	while (new_capacity < capacity)
+		new_capacity *= 2;
+
+	files = malloc (new_capacity * sizeof *files);
+	if (files == NULL)
+		return false;
+	open = realloc (t->open, new_capacity / FD_WORD_BITS * sizeof *open);
+	if (open == NULL) {
+		free (files);
+		return false;
+	}
+	memset (open + old_words, 0,
+			(new_capacity / FD_WORD_BITS - old_words) * sizeof *open);
+	t->open = open;
+
+	if (t->capacity != 0)
+		memcpy (files, old_files, t->capacity * sizeof *files);
+	memset (files + t->capacity, 0,
+			(new_capacity - t->capacity) * sizeof *files);
+	/* A reader that sees the new capacity sees the new FILES. */
+	rcu_assign_pointer (t->files, files);
+	rcu_assign_pointer (t->capacity, new_capacity);
+	synchronize_rcu ();
+	free (old_files);
+	return true;
+}
+
+/* Makes descriptor FD in T refer to FILE. */
+static void
+set_entry (struct fd_table *t, int fd, struct file *file) {
+	uint64_t *word = &t->open[fd / FD_WORD_BITS];
+
+	rcu_assign_pointer (t->files[fd], file);
+	*word |= 1ULL << fd % FD_WORD_BITS;
+	if (*word == UINT64_MAX)
+		t->full |= 1ULL << fd / FD_WORD_BITS;
+}
+
+/* Marks descriptor FD in T free.  The caller must wait for a grace
+   period before dropping the table's reference to its file. */
+static void
+clear_entry (struct fd_table *t, int fd) {
+	rcu_assign_pointer (t->files[fd], NULL);
+	t->open[fd / FD_WORD_BITS] &= ~(1ULL << fd % FD_WORD_BITS);
+	t->full &= ~(1ULL << fd / FD_WORD_BITS);
+}
+
+/* Returns the lowest free descriptor in T, which is T's capacity
+   if all the descriptors it holds are open, or -1 if FD_MAX are
+   open. */
+static int
+lowest_free (const struct fd_table *t) {
+	int word;
+
+	if (t->full == UINT64_MAX)
+		return -1;
+	word = __builtin_ctzll (~t->full);
+	if (word * FD_WORD_BITS >= t->capacity)
+		return t->capacity;
+	return word * FD_WORD_BITS + __builtin_ctzll (~t->open[word]);
+}
+
+/* Returns a new table with no open descriptors, or a null pointer
+   if out of memory. */
+static struct fd_table *
+alloc_table (void) {
+	struct fd_table *t = calloc (1, sizeof *t);
+
+	if (t == NULL)
+		return NULL;
+	lock_init (&t->lock);
+	if (!grow (t, FD_INIT_CAPACITY)) {
+		fd_table_destroy (t);
+		return NULL;
+	}
+	return t;
+}
+
+/* Returns a new table for a process's first program, with
+   descriptor 0 reading the keyboard and 1 and 2 writing the
+   console.  Returns a null pointer if out of memory. */
+struct fd_table *
+fd_table_create (void) {
+	struct fd_table *t = alloc_table ();
+
+	if (t != NULL) {
+		set_entry (t, 0, FD_CONSOLE_IN);
+		set_entry (t, 1, FD_CONSOLE_OUT);
+		set_entry (t, 2, FD_CONSOLE_OUT);
+	}
+	return t;
+}
+
+/* A file in the parent's table and its copy in the child's. */
+struct file_copy {
+	struct file *parent;
+	struct file *child;
+};
+
+/* Returns a copy of PARENT for a forked child, or a null pointer
+   if out of memory.  Each open file is duplicated once, so
+   descriptors that share a position in PARENT share one in the
+   copy too, but none are shared between parent and child. */
+struct fd_table *
+fd_table_copy (struct fd_table *parent) {
+	struct fd_table *child = alloc_table ();
+	struct file_copy *shared = NULL;
+	size_t shared_cnt = 0;
+	int w;
+
+	if (child == NULL)
+		return NULL;
+	lock_acquire (&parent->lock);
+	if (!grow (child, parent->capacity))
+		goto error;
+	for (w = 0; w < parent->capacity / FD_WORD_BITS; w++) {
+		uint64_t bits;
+
+		for (bits = parent->open[w]; bits != 0; bits &= bits - 1) {
+			int fd = w * FD_WORD_BITS + __builtin_ctzll (bits);
+			struct file *file = parent->files[fd];
+			struct file *copy = NULL;
+			size_t i;
+
+			if (fd_is_console (file)) {
+				set_entry (child, fd, file);
+				continue;
+			}
+
+			/* Only files that several descriptors share need to be
+			   remembered, and there are usually few of them. */
+			if (file_shared (file))
+				for (i = 0; i < shared_cnt; i++)
+					if (shared[i].parent == file) {
+						copy = file_share (shared[i].child);
+						break;
+					}
+			if (copy == NULL) {
+				copy = file_duplicate (file);
+				if (copy == NULL)
+					goto error;
+				if (file_shared (file)) {
+					if (shared == NULL)
+						shared = malloc (parent->capacity * sizeof *shared);
+					if (shared == NULL) {
+						file_close (copy);
+						goto error;
+					}
+					shared[shared_cnt].parent = file;
+					shared[shared_cnt++].child = copy;
+				}
+			}
+			set_entry (child, fd, copy);
+		}
+	}
+	lock_release (&parent->lock);
+	free (shared);
+	return child;
+
+error:
+	lock_release (&parent->lock);
+	free (shared);
+	fd_table_destroy (child);
+	return NULL;
+}
+
+/* Closes every descriptor in T and frees it.  T may be a null
+   pointer.  No other thread may be using T. */
+void
+fd_table_destroy (struct fd_table *t) {
+	int w;
+
+	if (t == NULL)
+		return;
+	for (w = 0; w < t->capacity / FD_WORD_BITS; w++) {
+		uint64_t bits;
+
+		for (bits = t->open[w]; bits != 0; bits &= bits - 1)
+			release (t->files[w * FD_WORD_BITS + __builtin_ctzll (bits)]);
+	}
+	free (t->files);
+	free (t->open);
+	free (t);
+}
+
+/* Opens the lowest free descriptor in T for FILE, taking over the
+   caller's reference to it.  Returns the descriptor, or -1 if T
+   is full or out of memory. */
+int
+fd_install (struct fd_table *t, struct file *file) {
+	int fd;
+
+	lock_acquire (&t->lock);
+	fd = lowest_free (t);
+	if (fd < 0 || !grow (t, fd + 1))
+		fd = -1;
+	else
+		set_entry (t, fd, file);
+	lock_release (&t->lock);
+	return fd;
+}
+
+/* Returns the file for descriptor FD in T, or a null pointer if FD
+   is not open.  The caller must hold T's lock or be inside an RCU
+   read-side critical section. */
+static struct file *
+lookup (struct fd_table *t, int fd) {
+	struct file **files;
+
+	if (fd < 0 || fd >= rcu_dereference (t->capacity))
+		return NULL;
+	files = rcu_dereference (t->files);
+	return rcu_dereference (files[fd]);
+}
+
+/* Returns the file for descriptor FD in T, which may be one of
+   the console entries, or a null pointer if FD is not open.  The
+   caller must pass a file that is not null to fd_put() when done
+   with it.  Takes no lock. */
+struct file *
+fd_get (struct fd_table *t, int fd) {
+	struct file *file;
+
+	rcu_read_lock ();
+	file = lookup (t, fd);
+	if (file != NULL && !fd_is_console (file))
+		file_share (file);
+	rcu_read_unlock ();
+	return file;
+}
+
+/* Drops the reference to FILE returned by fd_get() on T, closing
+   FILE if its descriptors have all been closed meanwhile. */
+void
+fd_put (struct fd_table *t UNUSED, struct file *file) {
+	release (file);
+}
+
+/* Closes descriptor FD in T.  Returns false if it was not open. */
+bool
+fd_close (struct fd_table *t, int fd) {
+	struct file *file;
+
+	lock_acquire (&t->lock);
+	file = lookup (t, fd);
+	if (file != NULL)
+		clear_entry (t, fd);
+	lock_release (&t->lock);
+	if (file == NULL)
+		return false;
+	synchronize_rcu ();
+	release (file);
+	return true;
+}
+
+/* Makes NEWFD in T refer to the same file as OLDFD, sharing its
+   position, after closing NEWFD if it was open.  Returns NEWFD,
+   or -1 if OLDFD is not open, NEWFD is out of range, or memory
+   runs out. */
+int
+fd_dup2 (struct fd_table *t, int oldfd, int newfd) {
+	struct file *file, *old = NULL;
+
+	if (newfd < 0 || newfd >= FD_MAX)
+		return -1;
+	lock_acquire (&t->lock);
+	file = lookup (t, oldfd);
+	if (file == NULL || !grow (t, newfd + 1)) {
+		lock_release (&t->lock);
+		return -1;
+	}
+	if (oldfd != newfd) {
+		old = lookup (t, newfd);
+		set_entry (t, newfd, fd_is_console (file) ? file : file_share (file));
+	}
+	lock_release (&t->lock);
+	if (old != NULL) {
+		synchronize_rcu ();
+		release (old);
+	}
+	return newfd;
+}
@@ -0,0 +1,274 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <futex.h>
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Futexes.
+
+   A futex is named by the kernel address of the word, that is, by
+   the frame that holds it and the offset within.  Two processes
+   that map one file page thus name the same futex through their
+   different user addresses.
+
+   Sleepers wait in a hash table of queues, one lock each.  A
+   frame that is about to hold another page must not keep its
+   sleepers, who would then never be woken through the page's new
+   frame, so eviction wakes them all first.  They find the word
+   unchanged and sleep again under the new name, as they must be
+   prepared to do anyway. */
+
+/* Queues in the hash table. */
+#define FUTEX_BUCKETS 256
+
+/* A queue of sleepers on futexes that hash alike. */
+struct futex_bucket {
+	struct lock lock;
+	struct list waiters;                /* struct futex_waiter, FIFO. */
+	char name[sizeof "futex[255]"];     /* The lock's, for statistics. */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping on a futex, on its own stack.  WOKEN and
+   SLEEPING change only with interrupts off. */
+struct futex_waiter {
+	uint64_t key;                       /* Kernel address of the word. */
+	struct thread *thread;
+	bool timed;                         /* Also on the sleep queue? */
+	bool sleeping;                      /* Blocked, or about to be? */
+	bool woken;                         /* Taken off the queue by a waker? */
+	struct list_elem elem;              /* In its bucket's WAITERS. */
+};
+
+/* Initializes the futex table. */
+void
+futex_init (void) {
+	size_t i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		lock_init (&buckets[i].lock);
+		snprintf (buckets[i].name, sizeof buckets[i].name, "futex[%zu]", i);
+		lock_set_name (&buckets[i].lock, buckets[i].name);
+		list_init (&buckets[i].waiters);
+	}
+}
+
+/* Returns the queue for futexes named KEY. */
+static struct futex_bucket *
+bucket_of (uint64_t key) {
+	return &buckets[hash_bytes (&key, sizeof key) % FUTEX_BUCKETS];
+}
+
+/* Returns true if UADDR is a user address a futex may live at. */
+static bool
+valid_uaddr (const int *uaddr) {
+	return (uint64_t) uaddr % sizeof *uaddr == 0 && is_user_vaddr (uaddr);
+}
+
+/* Takes W off its queue, whose lock the caller holds, and wakes its
+   thread if it is already asleep. */
+static void
+wake (struct futex_waiter *w) {
+	enum intr_level old_level = intr_disable ();
+
+	list_remove (&w->elem);
+	w->woken = true;
+	if (w->sleeping && w->thread->status == THREAD_BLOCKED) {
+		if (w->timed)
+			thread_wake_early (w->thread);
+		else
+			thread_unblock (w->thread);
+	}
+	intr_set_level (old_level);
+}
+
+/* Wakes every sleeper in the table for which PRED (W, AUX) is
+   true. */
+static void
+wake_all_if (bool (*pred) (const struct futex_waiter *, const void *),
+		const void *aux) {
+	size_t i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		struct futex_bucket *b = &buckets[i];
+		struct list_elem *e;
+
+		lock_acquire (&b->lock);
+		for (e = list_begin (&b->waiters); e != list_end (&b->waiters);) {
+			struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+			e = list_next (e);
+			if (pred (w, aux))
+				wake (w);
+		}
+		lock_release (&b->lock);
+	}
+}
+
+/* Sleeps until another thread wakes the futex at UADDR, provided
+   it holds VAL, or until TIMEOUT_MS milliseconds pass, unless
+   TIMEOUT_MS is negative.  Returns FUTEX_WOKEN, FUTEX_MISMATCH or
+   FUTEX_TIMEDOUT, or -1 if UADDR is not a mapped, aligned user
+   address.  Also returns, as if timed out, once the process
+   starts exiting. */
+int
+futex_wait (int *uaddr, int val, int64_t timeout_ms) {
+	struct thread *curr = thread_current ();
+	struct futex_waiter w;
+	struct futex_bucket *b;
+	enum intr_level old_level;
+	int64_t ticks = 0;
+	int *kaddr;
+	bool woken;
+#ifdef VM
+	bool locked;
+#endif
+
+	if (!valid_uaddr (uaddr))
+		return -1;
+	if (timeout_ms >= 0 && timeout_ms < INT64_MAX / TIMER_FREQ)
+		ticks = (timeout_ms * TIMER_FREQ + 999) / 1000;
+	else
+		timeout_ms = -1;
+
+	/* Keep the word's frame from being evicted until we are on its
+	   queue, where eviction will find us. */
+#ifdef VM
+	locked = vm_lock ();
+	kaddr = vm_user_kva (uaddr, true);
+#else
+	kaddr = pml4_get_page (curr->pml4, uaddr);
+#endif
+	if (kaddr == NULL) {
+#ifdef VM
+		vm_unlock (locked);
+#endif
+		return -1;
+	}
+
+	w.key = (uint64_t) kaddr;
+	w.thread = curr;
+	w.timed = timeout_ms >= 0;
+	w.sleeping = false;
+	w.woken = false;
+	b = bucket_of (w.key);
+
+	/* A waker changes the word before taking the lock, so checking
+	   the word under it cannot miss a wakeup. */
+	lock_acquire (&b->lock);
+	if (*(volatile int *) kaddr != val) {
+		lock_release (&b->lock);
+#ifdef VM
+		vm_unlock (locked);
+#endif
+		return FUTEX_MISMATCH;
+	}
+	list_push_back (&b->waiters, &w.elem);
+	lock_release (&b->lock);
+#ifdef VM
+	vm_unlock (locked);
+#endif
+
+	old_level = intr_disable ();
+	if (!w.woken && !curr->proc->exiting) {
+		w.sleeping = true;
+		if (w.timed)
+			thread_sleep (timer_ticks () + ticks);
+		else
+			thread_block ();
+		w.sleeping = false;
+	}
+	intr_set_level (old_level);
+
+	lock_acquire (&b->lock);
+	woken = w.woken;
+	if (!woken)
+		list_remove (&w.elem);
+	lock_release (&b->lock);
+	return woken ? FUTEX_WOKEN : FUTEX_TIMEDOUT;
+}
+
+/* Wakes up to CNT threads sleeping on the futex at UADDR, oldest
+   first.  Returns the number woken, or -1 if UADDR is not an
+   aligned user address. */
+int
+futex_wake (int *uaddr, int cnt) {
+	struct futex_bucket *b;
+	struct list_elem *e;
+	uint64_t key;
+	int *kaddr;
+	int woken = 0;
+#ifdef VM
+	bool locked;
+#endif
+
+	if (!valid_uaddr (uaddr))
+		return -1;
+
+	/* A word that is not resident has no sleepers: eviction woke
+	   them, and sleeping would have brought it back in. */
+#ifdef VM
+	locked = vm_lock ();
+	kaddr = vm_user_kva (uaddr, false);
+	vm_unlock (locked);
+#else
+	kaddr = pml4_get_page (thread_current ()->pml4, uaddr);
+#endif
+	if (kaddr == NULL)
+		return 0;
+
+	key = (uint64_t) kaddr;
+	b = bucket_of (key);
+	lock_acquire (&b->lock);
+	for (e = list_begin (&b->waiters);
+			e != list_end (&b->waiters) && woken < cnt;) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		e = list_next (e);
+		if (w->key == key) {
+			wake (w);
+			woken++;
+		}
+	}
+	lock_release (&b->lock);
+	return woken;
+}
+
+/* Returns true if W sleeps on a futex in the frame at AUX. */
+static bool
+in_frame (const struct futex_waiter *w, const void *aux) {
+	return w->key - (uint64_t) aux < PGSIZE;
+}
+
+/* Wakes every thread sleeping on a futex in the frame at KVA,
+   which is about to hold a different page.  Called with the VM
+   lock held. */
+void
+futex_frame_moved (void *kva) {
+	wake_all_if (in_frame, kva);
+}
+
+/* Returns true if W's thread belongs to process AUX. */
+static bool
+in_process (const struct futex_waiter *w, const void *aux) {
+	return w->thread->proc == aux;
+}
+
+/* Wakes the threads of process PROC, which is exiting, that sleep
+   on futexes. */
+void
+futex_cancel (struct thread *proc) {
+	wake_all_if (in_process, proc);
+}
@@ -116,7 +116,7 @@ gdt_init (void) {
 			"movabs $1f, %%rax\n"
 			"pushq %%rax\n"
 			"lretq\n"
-			"1:\n" :: "b" (SEL_KCSEG):"cc","memory");
+			"1:\n" :: "b" (SEL_KCSEG):"rax","cc","memory");
 	/* Kill the local descriptor table */
 	lldt (0);
 }
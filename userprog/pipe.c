@@ -0,0 +1,416 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <list.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pollq.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* Pipes.
+
+   A pipe's data lives in a ring of up to PIPE_PAGES pages, taken
+   from the kernel pool as the writer first needs them.  HEAD and
+   TAIL count the bytes read and written since the pipe was made,
+   so byte N is at offset N % PGSIZE in page N / PGSIZE of the ring.
+
+   User buffers are copied through a bounce page outside the pipe's
+   lock, so that a fault on one, which may have to read the page in
+   from disk, does not hold up the other end.  Each thread keeps its
+   bounce page from one call to the next; see uaccess_bounce_get().
+   Whole pages move between the bounce pages and the ring by trading
+   them instead of copying: a writer with a full page for a
+   page-aligned TAIL puts its bounce page in the ring and takes the
+   slot's old page as its next bounce page, and a reader wanting a
+   full page at a page-aligned HEAD trades its bounce page for the
+   ring's.  That saves one copy each way, but the copies to and from
+   user memory remain.  Handing or pinning the user pages themselves
+   would save those too, but user pages belong to the supplemental
+   page table and frame table, which give no way to transfer or pin
+   one.
+
+   A write of at most PIPE_BUF bytes is atomic: the writer waits
+   until the ring has room for all of it before placing any, so no
+   other writer's bytes land in the middle.  Larger writes go a
+   page at a time, and may interleave with others between pages.
+
+   Threads wait for a pipe on its READ_WAITERS or WRITE_WAITERS
+   queue, and are also listed in ALL_WAITERS so that pipe_cancel()
+   can find the ones of an exiting process without looking at every
+   pipe. */
+
+/* Pages in a pipe's ring, and bytes it can hold. */
+#define PIPE_PAGES 16
+#define PIPE_SIZE (PIPE_PAGES * PGSIZE)
+
+struct pipe {
+	struct lock lock;                   /* Protects the rest. */
+	struct list read_waiters;           /* Wait for data or no writers. */
+	struct list write_waiters;          /* Wait for room or no readers. */
+	uint8_t *pages[PIPE_PAGES];         /* Ring, or nulls not yet needed. */
+	uint64_t head;                      /* Bytes read so far. */
+	uint64_t tail;                      /* Bytes written so far. */
+	int readers;                        /* Open reading ends. */
+	int writers;                        /* Open writing ends. */
+	int watchers;                       /* References that are no end. */
+	struct poll_queue poll;             /* Waiters in poll() and epoll. */
+};
+
+/* A thread waiting on a pipe, on its own stack.  WOKEN and
+   SLEEPING change only with interrupts off. */
+struct pipe_waiter {
+	struct thread *thread;
+	bool sleeping;                      /* Blocked, or about to be? */
+	bool woken;                         /* Woken since it queued? */
+	struct list_elem elem;              /* In a pipe's queue, under its
+	                                       lock. */
+	struct list_elem all_elem;          /* In ALL_WAITERS. */
+};
+
+/* Every pipe_waiter, for pipe_cancel().  Protected by turning
+   interrupts off. */
+static struct list all_waiters;
+
+/* Initializes the pipe module. */
+void
+pipe_init (void) {
+	list_init (&all_waiters);
+}
+
+/* Returns a new, empty pipe with one reading and one writing end
+   open, or a null pointer if out of memory. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *p = calloc (1, sizeof *p);
+
+	if (p == NULL)
+		return NULL;
+	lock_init (&p->lock);
+	list_init (&p->read_waiters);
+	list_init (&p->write_waiters);
+	poll_queue_init (&p->poll);
+	p->readers = 1;
+	p->writers = 1;
+	return p;
+}
+
+/* Frees P, whose ends and watchers are all gone. */
+static void
+free_pipe (struct pipe *p) {
+	size_t i;
+
+	for (i = 0; i < PIPE_PAGES; i++)
+		palloc_free_page (p->pages[i]);
+	free (p);
+}
+
+/* Wakes W's thread if it is already asleep. */
+static void
+wake (struct pipe_waiter *w) {
+	enum intr_level old_level = intr_disable ();
+
+	w->woken = true;
+	if (w->sleeping && w->thread->status == THREAD_BLOCKED)
+		thread_unblock (w->thread);
+	intr_set_level (old_level);
+}
+
+/* Wakes every thread on QUEUE, a queue of a pipe whose lock the
+   caller holds.  Each takes itself off once it has the lock. */
+static void
+wake_all (struct list *queue) {
+	struct list_elem *e;
+
+	for (e = list_begin (queue); e != list_end (queue); e = list_next (e))
+		wake (list_entry (e, struct pipe_waiter, elem));
+}
+
+/* Returns true if the calling thread's process is exiting, in
+   which case it must not wait any longer. */
+static bool
+exiting (void) {
+	return thread_current ()->proc->exiting;
+}
+
+/* Waits on QUEUE of P until woken by wake_all() or pipe_cancel().
+   The caller holds P's lock, which is released meanwhile. */
+static void
+wait_on (struct pipe *p, struct list *queue) {
+	struct pipe_waiter w;
+	enum intr_level old_level;
+
+	w.thread = thread_current ();
+	w.sleeping = false;
+	w.woken = false;
+	list_push_back (queue, &w.elem);
+	old_level = intr_disable ();
+	list_push_back (&all_waiters, &w.all_elem);
+	intr_set_level (old_level);
+	lock_release (&p->lock);
+
+	old_level = intr_disable ();
+	if (!w.woken && !exiting ()) {
+		w.sleeping = true;
+		thread_block ();
+		w.sleeping = false;
+	}
+	list_remove (&w.all_elem);
+	intr_set_level (old_level);
+
+	lock_acquire (&p->lock);
+	list_remove (&w.elem);
+}
+
+/* Opens another reading or, if WRITER, writing end of P. */
+void
+pipe_open_end (struct pipe *p, bool writer) {
+	lock_acquire (&p->lock);
+	if (writer)
+		p->writers++;
+	else
+		p->readers++;
+	lock_release (&p->lock);
+}
+
+/* Closes a reading or, if WRITER, writing end of P.  Closing the
+   last writing end gives readers end of file, and closing the last
+   reading end makes writes fail.  P is freed when both are gone
+   and nothing watches it. */
+void
+pipe_close_end (struct pipe *p, bool writer) {
+	bool unused;
+
+	lock_acquire (&p->lock);
+	if (writer) {
+		ASSERT (p->writers > 0);
+		if (--p->writers == 0) {
+			wake_all (&p->read_waiters);
+			poll_queue_wake (&p->poll, POLLIN | POLLHUP);
+		}
+	} else {
+		ASSERT (p->readers > 0);
+		if (--p->readers == 0) {
+			wake_all (&p->write_waiters);
+			poll_queue_wake (&p->poll, POLLOUT | POLLERR);
+		}
+	}
+	unused = p->readers == 0 && p->writers == 0 && p->watchers == 0;
+	lock_release (&p->lock);
+	if (unused)
+		free_pipe (p);
+}
+
+/* Keeps P from being freed, so that it can still be polled,
+   without counting as an end of it.  For an interest set, whose
+   items must not keep a pipe from reaching end of file. */
+void
+pipe_watch (struct pipe *p) {
+	lock_acquire (&p->lock);
+	p->watchers++;
+	lock_release (&p->lock);
+}
+
+/* Drops a reference to P taken by pipe_watch(), freeing P if it
+   was the last thing keeping it. */
+void
+pipe_unwatch (struct pipe *p) {
+	bool unused;
+
+	lock_acquire (&p->lock);
+	ASSERT (p->watchers > 0);
+	unused = --p->watchers == 0 && p->readers == 0 && p->writers == 0;
+	lock_release (&p->lock);
+	if (unused)
+		free_pipe (p);
+}
+
+/* Moves up to SIZE bytes, but no more than one page, from the head
+   of P, whose lock the caller holds and which must not be empty,
+   into the page *BOUNCE, which may be traded for a page of the
+   ring.  Returns the bytes moved. */
+static size_t
+take (struct pipe *p, uint8_t **bounce, size_t size) {
+	size_t slot = p->head / PGSIZE % PIPE_PAGES;
+	size_t ofs = p->head % PGSIZE;
+	size_t chunk = PGSIZE - ofs;
+
+	if (chunk > size)
+		chunk = size;
+	if (chunk > p->tail - p->head)
+		chunk = p->tail - p->head;
+	if (chunk == PGSIZE) {
+		uint8_t *page = p->pages[slot];
+
+		p->pages[slot] = *bounce;
+		*bounce = page;
+	} else
+		memcpy (*bounce, p->pages[slot] + ofs, chunk);
+	p->head += chunk;
+	wake_all (&p->write_waiters);
+	poll_queue_wake (&p->poll, POLLOUT);
+	return chunk;
+}
+
+/* Reads up to SIZE bytes from P into user buffer UBUF, waiting
+   until there is at least one byte to read unless every writing
+   end is closed.  Returns the bytes read, 0 at end of file, -1 if
+   out of memory, or PIPE_FAULT if UBUF is bad. */
+int
+pipe_read (struct pipe *p, void *ubuf, unsigned size) {
+	uint8_t *bounce = uaccess_bounce_get ();
+	unsigned total = 0;
+
+	if (bounce == NULL)
+		return -1;
+	lock_acquire (&p->lock);
+	while (p->head == p->tail && p->writers > 0 && !exiting ())
+		wait_on (p, &p->read_waiters);
+	while (total < size && p->head != p->tail) {
+		size_t chunk = take (p, &bounce, size - total);
+
+		lock_release (&p->lock);
+		if (!copy_to_user ((uint8_t *) ubuf + total, bounce, chunk)) {
+			uaccess_bounce_put (bounce);
+			return PIPE_FAULT;
+		}
+		total += chunk;
+		lock_acquire (&p->lock);
+	}
+	lock_release (&p->lock);
+	uaccess_bounce_put (bounce);
+	return total;
+}
+
+/* Makes sure P's ring has a page in SLOT.  Returns false if out
+   of memory. */
+static bool
+fill_slot (struct pipe *p, size_t slot) {
+	if (p->pages[slot] == NULL)
+		p->pages[slot] = palloc_get_page (0);
+	return p->pages[slot] != NULL;
+}
+
+/* Moves SIZE bytes, at most PIPE_BUF, from the page *BOUNCE to the
+   tail of P, whose lock the caller holds.  Waits until there is
+   room for all of them before placing any, so that they do not
+   interleave with another writer's.  A full page at a page-aligned
+   tail is traded for the ring's page in its slot, which may be
+   null.  Returns SIZE, or 0 if every reading end was closed
+   meanwhile, the process is exiting or memory ran out. */
+static size_t
+put (struct pipe *p, uint8_t **bounce, size_t size) {
+	size_t slot, ofs, next, first;
+
+	ASSERT (size <= PIPE_BUF);
+
+	while (PIPE_SIZE - (p->tail - p->head) < size && p->readers > 0
+			&& !exiting ())
+		wait_on (p, &p->write_waiters);
+	if (p->readers == 0 || exiting ())
+		return 0;
+
+	slot = p->tail / PGSIZE % PIPE_PAGES;
+	ofs = p->tail % PGSIZE;
+	if (size == PGSIZE && ofs == 0) {
+		uint8_t *page = p->pages[slot];
+
+		p->pages[slot] = *bounce;
+		*bounce = page;
+	} else {
+		/* The bytes may run on into the next slot. */
+		next = (slot + 1) % PIPE_PAGES;
+		first = PGSIZE - ofs < size ? PGSIZE - ofs : size;
+		if (!fill_slot (p, slot) || (first < size && !fill_slot (p, next)))
+			return 0;
+		memcpy (p->pages[slot] + ofs, *bounce, first);
+		if (first < size)
+			memcpy (p->pages[next], *bounce + first, size - first);
+	}
+	p->tail += size;
+	wake_all (&p->read_waiters);
+	poll_queue_wake (&p->poll, POLLIN);
+	return size;
+}
+
+/* Writes SIZE bytes from user buffer UBUF to P, waiting for room
+   as needed.  Returns the bytes written, which are fewer than SIZE
+   only if every reading end was closed meanwhile or memory ran
+   out, -1 if none could be written, or PIPE_FAULT if UBUF is
+   bad. */
+int
+pipe_write (struct pipe *p, const void *ubuf, unsigned size) {
+	uint8_t *bounce = NULL;
+	unsigned total = 0;
+
+	while (total < size) {
+		size_t chunk = size - total < PIPE_BUF ? size - total : PIPE_BUF;
+		size_t done;
+
+		/* A page traded into the ring may leave none. */
+		if (bounce == NULL && (bounce = uaccess_bounce_get ()) == NULL)
+			break;
+		if (!copy_from_user (bounce, (const uint8_t *) ubuf + total, chunk)) {
+			uaccess_bounce_put (bounce);
+			return PIPE_FAULT;
+		}
+		lock_acquire (&p->lock);
+		done = put (p, &bounce, chunk);
+		lock_release (&p->lock);
+		total += done;
+		if (done < chunk)
+			break;
+	}
+	uaccess_bounce_put (bounce);
+	return total > 0 || size == 0 ? (int) total : -1;
+}
+
+/* Returns the events that are ready on the reading or, if WRITER,
+   the writing end of P: POLLIN if a read would not wait, POLLHUP
+   if no writing end is open, POLLOUT if a write would not wait and
+   POLLERR if no reading end is open.  If W is not null, it is also
+   added to the queue of waiters told when these change. */
+unsigned
+pipe_poll (struct pipe *p, bool writer, struct poll_waiter *w) {
+	unsigned events = 0;
+
+	lock_acquire (&p->lock);
+	if (w != NULL)
+		poll_queue_add (&p->poll, w);
+	if (writer) {
+		if (p->readers == 0)
+			events |= POLLERR | POLLOUT;
+		else if (p->tail - p->head < PIPE_SIZE)
+			events |= POLLOUT;
+	} else {
+		if (p->writers == 0)
+			events |= POLLHUP | POLLIN;
+		else if (p->head != p->tail)
+			events |= POLLIN;
+	}
+	lock_release (&p->lock);
+	return events;
+}
+
+/* Wakes the threads of process PROC that wait on a pipe, so that
+   they notice PROC is exiting. */
+void
+pipe_cancel (struct thread *proc) {
+	enum intr_level old_level;
+	struct list_elem *e;
+
+	old_level = intr_disable ();
+	for (e = list_begin (&all_waiters); e != list_end (&all_waiters);
+			e = list_next (e)) {
+		struct pipe_waiter *w = list_entry (e, struct pipe_waiter, all_elem);
+
+		if (w->thread->proc == proc)
+			wake (w);
+	}
+	intr_set_level (old_level);
+}
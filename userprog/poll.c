@@ -0,0 +1,558 @@
+#include "userprog/poll.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stddef.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/pollq.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/fdtable.h"
+#include "userprog/uaccess.h"
+
+/* Readiness notification.
+
+   poll() and epoll_wait() sleep until a descriptor becomes ready
+   without looking at any descriptor meanwhile.  Each object that
+   can be waited for, such as the keyboard, a pipe or an interest
+   set, keeps a queue of waiters (see threads/pollq.h) and calls
+   them when its readiness changes.
+
+   poll() puts a waiter on the queue of each descriptor it is
+   given, sleeps until one of them is called, and then checks every
+   descriptor again, so a call takes time in proportion to the
+   descriptors it watches.
+
+   An interest set made by epoll_create() instead keeps a waiter on
+   the queue of each of its descriptors for as long as the
+   descriptor is in the set.  The waiter moves its item to the
+   set's ready list, so that epoll_wait() looks only at items that
+   became ready, however many the set holds.  Reported items are
+   checked again each time and stay on the ready list for as long
+   as they are ready, unless EPOLLET was asked for.
+
+   An item keeps its own file for the descriptor, made by
+   file_watch(), which for a pipe does not count as an end of it.
+   Closing the descriptor therefore leaves the item in the set, until
+   EPOLL_CTL_DEL removes it by number or the set is closed, while
+   closing a pipe's last end still reaches the other end. */
+
+/* A thread sleeping in poll() or epoll_wait().  SLEEPING and
+   WOKEN change only with interrupts off. */
+struct sleeper {
+	struct thread *thread;
+	int64_t deadline;                   /* Tick to give up at, if TIMED. */
+	bool timed;                         /* Give up at DEADLINE? */
+	bool sleeping;                      /* Blocked, or about to be? */
+	bool woken;                         /* Woken since it last slept? */
+	struct list_elem elem;              /* In all_sleepers. */
+};
+
+/* A sleeper's waiter on one queue. */
+struct poll_entry {
+	struct poll_waiter waiter;
+	struct sleeper *sleeper;
+	unsigned events;                    /* Events that wake SLEEPER. */
+	struct file *file;                  /* Descriptor's file, for poll(). */
+};
+
+/* Every sleeper, for poll_cancel().  Protected by turning
+   interrupts off. */
+static struct list all_sleepers;
+
+/* An interest set. */
+struct epoll {
+	struct lock lock;                   /* Protects ITEMS and REF_CNT. */
+	struct hash items;                  /* struct epoll_item, by descriptor. */
+	struct list ready;                  /* Items that may be ready. */
+	struct poll_queue waiters;          /* Threads waiting for READY. */
+	int ref_cnt;                        /* Files open on the set. */
+};
+
+/* A descriptor in an interest set.  EVENTS, ON_READY and the set's
+   READY list change only with interrupts off. */
+struct epoll_item {
+	struct hash_elem hash_elem;         /* In the set's ITEMS. */
+	struct list_elem ready_elem;        /* In the set's READY, if ON_READY. */
+	struct poll_waiter waiter;          /* On FILE's queue. */
+	struct epoll *ep;                   /* Set it belongs to. */
+	struct file *file;                  /* Own copy, or a console entry. */
+	int fd;                             /* Descriptor. */
+	uint32_t events;                    /* Events of interest. */
+	uint64_t data;                      /* Reported with them. */
+	bool on_ready;                      /* In READY? */
+};
+
+/* Initializes the poll module. */
+void
+poll_init (void) {
+	list_init (&all_sleepers);
+}
+
+/* Returns the events ready on FILE, an entry of a descriptor
+   table, adding W to the queue of waiters told when they change
+   if W is not null.  Files in the file system are always ready,
+   and never change. */
+static unsigned
+fd_poll (struct file *file, struct poll_waiter *w) {
+	if (file == FD_CONSOLE_IN)
+		return input_poll (w);
+	if (file == FD_CONSOLE_OUT)
+		return POLLOUT;
+	return file_poll (file, w);
+}
+
+/* Initializes S for the running thread, to give up after
+   TIMEOUT_MS milliseconds unless TIMEOUT_MS is negative. */
+static void
+sleeper_init (struct sleeper *s, int64_t timeout_ms) {
+	enum intr_level old_level;
+
+	s->thread = thread_current ();
+	s->timed = timeout_ms >= 0 && timeout_ms < INT64_MAX / TIMER_FREQ;
+	s->deadline = s->timed
+		? timer_ticks () + (timeout_ms * TIMER_FREQ + 999) / 1000 : 0;
+	s->sleeping = false;
+	s->woken = false;
+	old_level = intr_disable ();
+	list_push_back (&all_sleepers, &s->elem);
+	intr_set_level (old_level);
+}
+
+/* Forgets S, whose waiters must all be off their queues. */
+static void
+sleeper_done (struct sleeper *s) {
+	enum intr_level old_level = intr_disable ();
+
+	list_remove (&s->elem);
+	intr_set_level (old_level);
+}
+
+/* Wakes S's thread if it sleeps, or keeps it from sleeping next.
+   Interrupts must be off. */
+static void
+sleeper_wake (struct sleeper *s) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	s->woken = true;
+	if (s->sleeping && s->thread->status == THREAD_BLOCKED) {
+		s->sleeping = false;
+		if (s->timed)
+			thread_wake_early (s->thread);
+		else
+			thread_unblock (s->thread);
+	}
+}
+
+/* Sleeps until S is woken, unless it was woken since it last
+   slept.  Returns false, without sleeping, once S's deadline
+   passes or its process starts exiting. */
+static bool
+sleeper_sleep (struct sleeper *s) {
+	struct thread *proc = s->thread->proc;
+	enum intr_level old_level = intr_disable ();
+	bool woken;
+
+	if (!s->woken && !proc->exiting
+			&& (!s->timed || timer_ticks () < s->deadline)) {
+		s->sleeping = true;
+		if (s->timed)
+			thread_sleep (s->deadline);
+		else
+			thread_block ();
+		s->sleeping = false;
+	}
+	woken = s->woken;
+	s->woken = false;
+	intr_set_level (old_level);
+	return woken && !proc->exiting;
+}
+
+/* Wakes a poll entry's sleeper if EVENTS are among those it waits
+   for. */
+static void
+wake_entry (struct poll_waiter *w, unsigned events) {
+	struct poll_entry *e = (struct poll_entry *)
+		((uint8_t *) w - offsetof (struct poll_entry, waiter));
+
+	if (events & e->events)
+		sleeper_wake (e->sleeper);
+}
+
+/* Waits until one of the NFDS descriptors in user array UFDS is
+   ready for the events asked for, or until TIMEOUT_MS milliseconds
+   pass, unless TIMEOUT_MS is negative, and sets the REVENTS of
+   each.  Returns the number of descriptors with events, 0 on
+   timeout, -1 if NFDS is too large or memory runs out, or
+   POLL_FAULT if UFDS is bad. */
+int
+poll_fds (struct pollfd *ufds, unsigned nfds, int64_t timeout_ms) {
+	struct thread *curr = thread_current ();
+	struct pollfd *fds = NULL;
+	struct poll_entry *entries = NULL;
+	struct sleeper s;
+	bool first = true;
+	int ready = -1;
+	unsigned i;
+
+	if (nfds > FD_MAX)
+		return -1;
+	if (nfds > 0) {
+		fds = malloc (nfds * sizeof *fds);
+		entries = malloc (nfds * sizeof *entries);
+		if (fds == NULL || entries == NULL)
+			goto done;
+		if (!copy_from_user (fds, ufds, nfds * sizeof *fds)) {
+			ready = POLL_FAULT;
+			goto done;
+		}
+	}
+
+	sleeper_init (&s, timeout_ms);
+	for (i = 0; i < nfds; i++) {
+		struct poll_entry *e = &entries[i];
+
+		poll_waiter_init (&e->waiter, wake_entry);
+		e->sleeper = &s;
+		e->events = (fds[i].events & (POLLIN | POLLOUT)) | POLLERR | POLLHUP;
+		e->file = fds[i].fd >= 0 ? fd_get (curr->fdt, fds[i].fd) : NULL;
+	}
+
+	/* The first pass puts a waiter on each queue, until a descriptor
+	   turns out to be ready and there is no need to wait. */
+	for (;;) {
+		ready = 0;
+		for (i = 0; i < nfds; i++) {
+			struct poll_entry *e = &entries[i];
+			unsigned revents = 0;
+
+			if (e->file != NULL)
+				revents = fd_poll (e->file,
+						first && ready == 0 ? &e->waiter : NULL) & e->events;
+			else if (fds[i].fd >= 0)
+				revents = POLLNVAL;
+			fds[i].revents = revents;
+			if (revents != 0)
+				ready++;
+		}
+		first = false;
+		if (ready > 0 || !sleeper_sleep (&s))
+			break;
+	}
+
+	for (i = 0; i < nfds; i++) {
+		poll_queue_remove (&entries[i].waiter);
+		if (entries[i].file != NULL)
+			fd_put (curr->fdt, entries[i].file);
+	}
+	sleeper_done (&s);
+	if (!copy_to_user (ufds, fds, nfds * sizeof *fds))
+		ready = POLL_FAULT;
+
+done:
+	free (fds);
+	free (entries);
+	return ready;
+}
+
+/* Wakes the threads of process PROC that sleep in poll() or
+   epoll_wait(), so that they notice PROC is exiting. */
+void
+poll_cancel (struct thread *proc) {
+	enum intr_level old_level = intr_disable ();
+	struct list_elem *e;
+
+	for (e = list_begin (&all_sleepers); e != list_end (&all_sleepers);
+			e = list_next (e)) {
+		struct sleeper *s = list_entry (e, struct sleeper, elem);
+
+		if (s->thread->proc == proc)
+			sleeper_wake (s);
+	}
+	intr_set_level (old_level);
+}
+
+static uint64_t
+item_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct epoll_item, hash_elem)->fd);
+}
+
+static bool
+item_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct epoll_item, hash_elem)->fd
+		< hash_entry (b, struct epoll_item, hash_elem)->fd;
+}
+
+/* Returns a new, empty interest set with one file open on it, or
+   a null pointer if out of memory. */
+struct epoll *
+epoll_create (void) {
+	struct epoll *ep = malloc (sizeof *ep);
+
+	if (ep == NULL)
+		return NULL;
+	if (!hash_init (&ep->items, item_hash, item_less, NULL)) {
+		free (ep);
+		return NULL;
+	}
+	lock_init (&ep->lock);
+	list_init (&ep->ready);
+	poll_queue_init (&ep->waiters);
+	ep->ref_cnt = 1;
+	return ep;
+}
+
+/* Notes another file open on EP. */
+void
+epoll_open (struct epoll *ep) {
+	lock_acquire (&ep->lock);
+	ep->ref_cnt++;
+	lock_release (&ep->lock);
+}
+
+/* Puts ITEM on its set's ready list, unless it is there already.
+   Returns true if it was not.  Interrupts must be off. */
+static bool
+mark_ready (struct epoll_item *item) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (item->on_ready)
+		return false;
+	list_push_back (&item->ep->ready, &item->ready_elem);
+	item->on_ready = true;
+	return true;
+}
+
+/* Called when EVENTS occur on an item's file.  If they are of
+   interest, makes the item ready and wakes the set's waiters. */
+static void
+wake_item (struct poll_waiter *w, unsigned events) {
+	struct epoll_item *item = (struct epoll_item *)
+		((uint8_t *) w - offsetof (struct epoll_item, waiter));
+
+	if ((events & (item->events | POLLERR | POLLHUP)) && mark_ready (item))
+		poll_queue_wake (&item->ep->waiters, POLLIN);
+}
+
+/* Takes ITEM off its file's queue and its set's ready list, and
+   frees it. */
+static void
+free_item (struct epoll_item *item) {
+	enum intr_level old_level;
+
+	poll_queue_remove (&item->waiter);
+	old_level = intr_disable ();
+	if (item->on_ready)
+		list_remove (&item->ready_elem);
+	intr_set_level (old_level);
+	if (!fd_is_console (item->file))
+		file_close (item->file);
+	free (item);
+}
+
+static void
+destroy_item (struct hash_elem *e, void *aux UNUSED) {
+	free_item (hash_entry (e, struct epoll_item, hash_elem));
+}
+
+/* Notes that a file open on EP was closed, and frees EP when the
+   last one is. */
+void
+epoll_close (struct epoll *ep) {
+	bool unused;
+
+	lock_acquire (&ep->lock);
+	unused = --ep->ref_cnt == 0;
+	lock_release (&ep->lock);
+	if (unused) {
+		hash_destroy (&ep->items, destroy_item);
+		free (ep);
+	}
+}
+
+/* Adds descriptor FD, whose file is FILE, to EP with the events
+   and data in EV. */
+static int
+add_item (struct epoll *ep, int fd, struct file *file,
+		const struct epoll_event *ev) {
+	struct epoll_item *item;
+	enum intr_level old_level;
+	unsigned events;
+
+	/* A set inside a set could contain itself. */
+	if (!fd_is_console (file) && file_get_epoll (file) != NULL)
+		return -1;
+	item = malloc (sizeof *item);
+	if (item == NULL)
+		return -1;
+	item->file = fd_is_console (file) ? file : file_watch (file);
+	if (item->file == NULL) {
+		free (item);
+		return -1;
+	}
+	poll_waiter_init (&item->waiter, wake_item);
+	item->ep = ep;
+	item->fd = fd;
+	item->events = ev->events;
+	item->data = ev->data;
+	item->on_ready = false;
+	hash_insert (&ep->items, &item->hash_elem);
+
+	events = fd_poll (item->file, &item->waiter);
+	old_level = intr_disable ();
+	wake_item (&item->waiter, events);
+	intr_set_level (old_level);
+	return 0;
+}
+
+/* Changes ITEM's events and data to those in EV. */
+static void
+modify_item (struct epoll_item *item, const struct epoll_event *ev) {
+	enum intr_level old_level;
+	unsigned events;
+
+	old_level = intr_disable ();
+	item->events = ev->events;
+	item->data = ev->data;
+	intr_set_level (old_level);
+
+	events = fd_poll (item->file, NULL);
+	old_level = intr_disable ();
+	wake_item (&item->waiter, events);
+	intr_set_level (old_level);
+}
+
+/* Performs epoll_ctl() operation OP on EP for descriptor FD,
+   whose file is FILE.  EV gives the events and data for
+   EPOLL_CTL_ADD and EPOLL_CTL_MOD, and is ignored by
+   EPOLL_CTL_DEL.  Returns 0 if successful, or -1 if FD is already
+   in EP when adding, is not in it otherwise, or is another
+   interest set, or if memory runs out. */
+int
+epoll_ctl (struct epoll *ep, int op, int fd, struct file *file,
+		const struct epoll_event *ev) {
+	struct epoll_item key, *item = NULL;
+	struct hash_elem *e;
+	int result = -1;
+
+	lock_acquire (&ep->lock);
+	key.fd = fd;
+	e = hash_find (&ep->items, &key.hash_elem);
+	if (e != NULL)
+		item = hash_entry (e, struct epoll_item, hash_elem);
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			if (item == NULL)
+				result = add_item (ep, fd, file, ev);
+			break;
+		case EPOLL_CTL_MOD:
+			if (item != NULL) {
+				modify_item (item, ev);
+				result = 0;
+			}
+			break;
+		case EPOLL_CTL_DEL:
+			if (item != NULL) {
+				hash_delete (&ep->items, &item->hash_elem);
+				free_item (item);
+				result = 0;
+			}
+			break;
+	}
+	lock_release (&ep->lock);
+	return result;
+}
+
+/* Reports up to MAXEVENTS of EP's ready items into user array
+   UEVENTS, looking at each item on the ready list at most once.
+   Returns the number reported, or POLL_FAULT if UEVENTS is bad.
+   The caller must hold EP's lock. */
+static int
+harvest (struct epoll *ep, struct epoll_event *uevents, int maxevents) {
+	enum intr_level old_level;
+	size_t left;
+	int cnt = 0;
+
+	old_level = intr_disable ();
+	left = list_size (&ep->ready);
+	intr_set_level (old_level);
+	for (; left > 0 && cnt < maxevents; left--) {
+		struct epoll_item *item;
+		struct epoll_event ev;
+
+		old_level = intr_disable ();
+		if (list_empty (&ep->ready)) {
+			intr_set_level (old_level);
+			break;
+		}
+		item = list_entry (list_pop_front (&ep->ready),
+				struct epoll_item, ready_elem);
+		item->on_ready = false;
+		intr_set_level (old_level);
+
+		ev.events = fd_poll (item->file, NULL)
+			& (item->events | POLLERR | POLLHUP) & ~EPOLLET;
+		if (ev.events == 0)
+			continue;
+		ev.data = item->data;
+		if (!(item->events & EPOLLET)) {
+			old_level = intr_disable ();
+			mark_ready (item);
+			intr_set_level (old_level);
+		}
+		if (!copy_to_user (&uevents[cnt], &ev, sizeof ev))
+			return POLL_FAULT;
+		cnt++;
+	}
+	return cnt;
+}
+
+/* Waits until one of EP's items is ready, or until TIMEOUT_MS
+   milliseconds pass, unless TIMEOUT_MS is negative, and reports up
+   to MAXEVENTS of them into user array UEVENTS.  Returns the
+   number reported, 0 on timeout, -1 if MAXEVENTS is not positive,
+   or POLL_FAULT if UEVENTS is bad. */
+int
+epoll_wait (struct epoll *ep, struct epoll_event *uevents, int maxevents,
+		int64_t timeout_ms) {
+	struct poll_entry entry;
+	struct sleeper s;
+	int cnt;
+
+	if (maxevents <= 0)
+		return -1;
+	sleeper_init (&s, timeout_ms);
+	poll_waiter_init (&entry.waiter, wake_entry);
+	entry.sleeper = &s;
+	entry.events = POLLIN;
+	entry.file = NULL;
+	poll_queue_add (&ep->waiters, &entry.waiter);
+	do {
+		lock_acquire (&ep->lock);
+		cnt = harvest (ep, uevents, maxevents);
+		lock_release (&ep->lock);
+	} while (cnt == 0 && sleeper_sleep (&s));
+	poll_queue_remove (&entry.waiter);
+	sleeper_done (&s);
+	return cnt;
+}
+
+/* Returns POLLIN if one of EP's items may be ready, and 0
+   otherwise.  If W is not null, it is also added to the queue of
+   waiters told when an item becomes ready. */
+unsigned
+epoll_poll (struct epoll *ep, struct poll_waiter *w) {
+	enum intr_level old_level = intr_disable ();
+	unsigned events;
+
+	if (w != NULL)
+		poll_queue_add (&ep->waiters, w);
+	events = list_empty (&ep->ready) ? 0 : POLLIN;
+	intr_set_level (old_level);
+	return events;
+}
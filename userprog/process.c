@@ -10,6 +10,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "devices/input.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -19,8 +20,15 @@
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #include "lib/kernel/list.h"
+#include "lib/kernel/hash.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "userprog/syscall.h"
+#include "userprog/fdtable.h"
+#include "userprog/futex.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
+#include "userprog/uaccess.h"
 
 #ifdef VM
 #include "vm/vm.h"
@@ -30,6 +38,139 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void spawn_child (void *);
+static void start_thread (void *);
+static void init_user_frame (struct intr_frame *);
+#ifndef VM
+static bool install_page (void *upage, void *kpage, bool writable);
+#endif
+
+/* Exit status of a child, shared by the child and its parent.
+ *
+ * The parent creates the record before the child's thread, and
+ * each holds a reference until it is done: the child when it
+ * exits, the parent when it waits for the child or exits itself.
+ * While the parent may still wait, the record sits in STATUSES
+ * under the child's tid, so that wait() finds it in constant time
+ * however many children there are, and on one of the parent's
+ * two lists, so that wait_any() finds an exited child at once. */
+struct child_status {
+	tid_t tid;                          /* Child's tid, or TID_ERROR. */
+	struct thread *parent;              /* Null once the parent exits. */
+	int exit_status;                    /* Valid once EXITED. */
+	bool exited;                        /* Has the child exited? */
+	int ref_cnt;                        /* Parent and child, at most. */
+	struct hash_elem hash_elem;         /* In STATUSES. */
+	struct list_elem elem;              /* In a parent's children or
+	                                       exited_children. */
+};
+
+/* Cache of exit status records. */
+static struct kmem_cache child_status_cache;
+
+/* Records whose parent can still wait for them, by tid. */
+static struct hash statuses;
+
+/* Protects STATUSES, every child_status, and the child lists of
+ * every thread.  A thread's child_exited is used with it. */
+static struct lock family_lock;
+
+static uint64_t
+child_status_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct child_status, hash_elem)->tid);
+}
+
+static bool
+child_status_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct child_status, hash_elem)->tid
+		< hash_entry (b, struct child_status, hash_elem)->tid;
+}
+
+/* Initializes the exit status records.  Must be called after
+ * malloc_init(). */
+void
+child_status_init (void) {
+	kmem_cache_init (&child_status_cache, "child_status",
+			sizeof (struct child_status), NULL);
+	if (!hash_init (&statuses, child_status_hash, child_status_less, NULL))
+		PANIC ("child_status_init: out of memory");
+	lock_init (&family_lock);
+	lock_set_name (&family_lock, "family");
+}
+
+/* Returns a new record for a child that PARENT is about to
+ * create, or a null pointer if out of memory. */
+static struct child_status *
+child_status_create (struct thread *parent) {
+	struct child_status *cs = kmem_cache_alloc (&child_status_cache);
+
+	if (cs == NULL)
+		return NULL;
+	cs->tid = TID_ERROR;
+	cs->parent = parent;
+	cs->exit_status = -1;
+	cs->exited = false;
+	cs->ref_cnt = 2;
+	lock_acquire (&family_lock);
+	list_push_back (&parent->children, &cs->elem);
+	lock_release (&family_lock);
+	return cs;
+}
+
+/* Records TID, as returned by thread_create(), as the tid of
+ * CS's child, or frees CS if creating the child failed.  Returns
+ * TID. */
+static tid_t
+child_status_publish (struct child_status *cs, tid_t tid) {
+	lock_acquire (&family_lock);
+	if (tid == TID_ERROR) {
+		list_remove (&cs->elem);
+		kmem_cache_free (&child_status_cache, cs);
+	} else {
+		cs->tid = tid;
+		hash_insert (&statuses, &cs->hash_elem);
+	}
+	lock_release (&family_lock);
+	return tid;
+}
+
+/* Drops a reference to CS, freeing it after the last one.  The
+ * caller must hold family_lock. */
+static void
+child_status_release (struct child_status *cs) {
+	ASSERT (lock_held_by_current_thread (&family_lock));
+	if (--cs->ref_cnt == 0)
+		kmem_cache_free (&child_status_cache, cs);
+}
+
+/* Takes CS away from its parent, which will no longer wait for
+ * it.  The caller must hold family_lock. */
+static void
+child_status_disown (struct child_status *cs) {
+	list_remove (&cs->elem);
+	if (cs->tid != TID_ERROR)
+		hash_delete (&statuses, &cs->hash_elem);
+	cs->parent = NULL;
+	child_status_release (cs);
+}
+
+/* Returns the record for the child of PARENT whose tid is TID, or
+ * a null pointer if PARENT has no such child to wait for.  The
+ * caller must hold family_lock. */
+static struct child_status *
+child_status_find (struct thread *parent, tid_t tid) {
+	struct child_status key;
+	struct hash_elem *e;
+	struct child_status *cs;
+
+	key.tid = tid;
+	e = hash_find (&statuses, &key.hash_elem);
+	if (e == NULL)
+		return NULL;
+	cs = hash_entry (e, struct child_status, hash_elem);
+	return cs->parent == parent ? cs : NULL;
+}
 
 /* General process initializer for initd and other process. */
 static void
@@ -37,6 +178,12 @@ process_init (void) {
 	struct thread *current = thread_current ();
 }
 
+/* Passed from process_create_initd() to initd(). */
+struct initd_args {
+	char *file_name;                    /* Command line, in its own page. */
+	struct child_status *exit_record;   /* Shared with the caller. */
+};
+
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
  * The new thread may be scheduled (and may even exit)
  * before process_create_initd() returns. Returns the initd's
@@ -44,6 +191,7 @@ process_init (void) {
  * Notice that THIS SHOULD BE CALLED ONCE. */
 tid_t
 process_create_initd (const char *file_name) {
+	struct initd_args *args;
 	char *fn_copy;
 	tid_t tid;
 
@@ -62,59 +210,91 @@ process_create_initd (const char *file_name) {
 	token = strtok_r(name, " ", &saveptr);
 	/* parsing 1st arg*/
 
+	args = malloc (sizeof *args);
+	if (args == NULL) {
+		palloc_free_page (fn_copy);
+		return TID_ERROR;
+	}
+	args->file_name = fn_copy;
+	args->exit_record = child_status_create (thread_current ()->proc);
+	if (args->exit_record == NULL) {
+		free (args);
+		palloc_free_page (fn_copy);
+		return TID_ERROR;
+	}
 
 	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (token, PRI_DEFAULT, initd, fn_copy);
-	if (tid == TID_ERROR)
+	tid = child_status_publish (args->exit_record,
+			thread_create (token, PRI_DEFAULT, initd, args));
+	if (tid == TID_ERROR) {
 		palloc_free_page (fn_copy);
+		free (args);
+	}
 	return tid;
 }
 
 /* A thread function that launches first user process. */
 static void
-initd (void *f_name) {
+initd (void *aux) {
+	struct initd_args *args = aux;
+	char *f_name = args->file_name;
+
+	thread_current ()->exit_record = args->exit_record;
+	free (args);
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
 
 	process_init ();
+	thread_current ()->fdt = fd_table_create ();
+	if (thread_current ()->fdt == NULL)
+		PANIC("Fail to launch initd\n");
 
 	if (process_exec (f_name) < 0)
 		PANIC("Fail to launch initd\n");
 	NOT_REACHED ();
 }
 
+/* Passed from process_fork() to __do_fork() on the parent's
+ * stack.  The parent waits on DONE before returning, so the child
+ * must not touch this after upping it. */
+struct fork_args {
+	struct thread *parent;
+	struct intr_frame if_;              /* Parent's user context. */
+	struct child_status *exit_record;   /* Shared with the parent. */
+	struct semaphore done;              /* Upped when the child is done
+	                                       copying the parent. */
+	bool success;                       /* Did it copy everything? */
+};
+
 /* Clones the current process as `name`. Returns the new process's thread id, or
  * TID_ERROR if the thread cannot be created. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
-	/* Clone current thread to new thread.*/
-	memcpy(&thread_current()->f, if_, sizeof(struct intr_frame));
-	tid_t child_tid = thread_create (name, PRI_DEFAULT, __do_fork, thread_current ());
-	if(child_tid == TID_ERROR)
+process_fork (const char *name, struct intr_frame *if_) {
+	struct fork_args args;
+	tid_t tid;
+
+	args.parent = thread_current ();
+	memcpy (&args.if_, if_, sizeof args.if_);
+	sema_init (&args.done, 0);
+	args.success = false;
+	args.exit_record = child_status_create (args.parent->proc);
+	if (args.exit_record == NULL)
 		return TID_ERROR;
 
-	struct list_elem *curr = list_begin(&thread_current()->child_list);
-	struct thread *child;
-	while (curr != list_end(&thread_current()->child_list))
-	{
-		child = list_entry(curr, struct thread, child_elem);
-		
-		if(child->tid == child_tid){
-			break;
-		}
-		curr = list_next(curr);
-	}
+	/* Clone current thread to new thread.*/
+	tid = child_status_publish (args.exit_record,
+			thread_create (name, PRI_DEFAULT, __do_fork, &args));
+	if (tid == TID_ERROR)
+		return TID_ERROR;
 
-	struct semaphore sema;
-	thread_current()->fork_sema = &sema;
-	sema_init(&sema, 0);
-	
-	sema_down(&sema);	
-	if (child->exit_status == -1) {
+	sema_down (&args.done);
+	if (!args.success) {
+		/* The child is on its way out.  Reap it. */
+		process_wait (tid);
 		return TID_ERROR;
 	}
-	return child_tid;
+	return tid;
 }
 
 #ifndef VM
@@ -166,15 +346,17 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
  *       this function. */
 static void
 __do_fork (void *aux) {
+	struct fork_args *args = aux;
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct thread *parent = args->parent;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if = &parent->f;
-	bool succ = true;
+
+	current->exit_record = args->exit_record;
 
 	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	memcpy (&if_, &args->if_, sizeof (struct intr_frame));
+	/* Before the parent can run user code again. */
+	thread_fpu_copy (parent);
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
 	if (current->pml4 == NULL)
@@ -184,39 +366,142 @@ __do_fork (void *aux) {
 	
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy (&current->spt, &parent->proc->spt))
 		goto error;
 #else
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
 		goto error;
 		
 #endif
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
+	current->fdt = fd_table_copy(parent->fdt);
+	if (current->fdt == NULL)
+		goto error;
+
+	process_init ();
+
+	if_.R.rax = 0;
+	args->success = true;
+	sema_up (&args->done);
+	/* Finally, switch to the newly created process. */
+	thread_fpu_acquire ();
+	do_iret (&if_);
+	NOT_REACHED ();
+
+error:
+	current->exit_status = TID_ERROR;
+	sema_up (&args->done);
+	thread_exit ();
+}
+
+/* Sets up IF_ to enter user mode with interrupts on. */
+static void
+init_user_frame (struct intr_frame *if_) {
+	memset (if_, 0, sizeof *if_);
+	if_->ds = if_->es = if_->ss = SEL_UDSEG;
+	if_->cs = SEL_UCSEG;
+	if_->eflags = FLAG_IF | FLAG_MBS;
+}
+
+/* Passed from process_spawn() to spawn_child() on the parent's
+ * stack.  As with fork_args, the child must not touch this after
+ * upping DONE. */
+struct spawn_args {
+	char *cmd_line;                     /* Program and arguments. */
+	struct fd_table *fdt;               /* Child's descriptors. */
+	struct child_status *exit_record;   /* Shared with the parent. */
+	struct semaphore done;              /* Upped when the child has
+	                                       loaded the program. */
+	bool success;                       /* Did the load succeed? */
+};
 
+/* Starts a new process running CMD_LINE, a program name followed
+ * by its arguments, as exec() takes it.  Unlike fork() followed by
+ * exec(), nothing of the caller's address space is copied: the
+ * child's is built from the executable by load().  The child gets
+ * a copy of the caller's descriptors, changed by the ACTION_CNT
+ * ACTIONS.  Returns the child's tid, or TID_ERROR if an action
+ * fails, the program cannot be loaded, or memory runs out.
+ * CMD_LINE stays the caller's; it is modified. */
+tid_t
+process_spawn (char *cmd_line, const struct spawn_action *actions,
+		size_t action_cnt) {
+	struct spawn_args args;
+	char name[sizeof thread_current ()->name];
+	size_t name_len = strcspn (cmd_line, " ");
+	size_t i;
+	tid_t tid;
 
+	/* Name the thread after the program. */
+	strlcpy (name, cmd_line,
+			name_len < sizeof name ? name_len + 1 : sizeof name);
+	args.cmd_line = cmd_line;
+	sema_init (&args.done, 0);
+	args.success = false;
 
-	for (int i = 3; i < maxfd; i++) {
-		if(parent->fdt[i] != NULL){
-			current->fdt[i] = file_duplicate(parent->fdt[i]);
+	args.fdt = fd_table_copy (thread_current ()->fdt);
+	if (args.fdt == NULL)
+		return TID_ERROR;
+	for (i = 0; i < action_cnt; i++) {
+		const struct spawn_action *a = &actions[i];
+		bool ok;
+
+		if (a->type == SPAWN_CLOSE)
+			ok = fd_close (args.fdt, a->fd);
+		else if (a->type == SPAWN_DUP2)
+			ok = fd_dup2 (args.fdt, a->fd, a->newfd) >= 0;
+		else
+			ok = false;
+		if (!ok) {
+			fd_table_destroy (args.fdt);
+			return TID_ERROR;
 		}
 	}
 
+	args.exit_record = child_status_create (thread_current ()->proc);
+	if (args.exit_record == NULL) {
+		fd_table_destroy (args.fdt);
+		return TID_ERROR;
+	}
+	tid = child_status_publish (args.exit_record,
+			thread_create (name, PRI_DEFAULT, spawn_child, &args));
+	if (tid == TID_ERROR) {
+		fd_table_destroy (args.fdt);
+		return TID_ERROR;
+	}
+
+	sema_down (&args.done);
+	if (!args.success) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* A thread function that loads the program for process_spawn(). */
+static void
+spawn_child (void *aux) {
+	struct spawn_args *args = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	bool success;
+
+	current->exit_record = args->exit_record;
+	current->fdt = args->fdt;
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
 	process_init ();
 
-	if_.R.rax = 0;
-	sema_up(thread_current()->parent->fork_sema);
-	/* Finally, switch to the newly created process. */
-	
-	if (succ)
-		do_iret (&if_);
-error:
-	sema_up(thread_current()->parent->fork_sema);
-	thread_current()->exit_status = TID_ERROR;
-	thread_exit ();
+	init_user_frame (&if_);
+	success = args->success = load (args->cmd_line, &if_);
+	sema_up (&args->done);
+	if (!success) {
+		current->exit_status = -1;
+		thread_exit ();
+	}
+	thread_fpu_acquire ();
+	do_iret (&if_);
+	NOT_REACHED ();
 }
 
 /* Switch the current execution context to the f_name.
@@ -231,12 +516,13 @@ process_exec (void *f_name) {
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
 	struct intr_frame _if;
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;
-	_if.cs = SEL_UCSEG;
-	_if.eflags = FLAG_IF | FLAG_MBS;
+	init_user_frame (&_if);
 
 	/* We first kill the current context */
 	process_cleanup ();
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+#endif
 
 	/* And then load the binary */
 	success = load (file_name, &_if);
@@ -250,115 +536,475 @@ process_exec (void *f_name) {
 	
 
 	/* Start switched process. */
+	thread_fpu_acquire ();
 	do_iret (&_if);
 	NOT_REACHED ();
 }
 
 
+/* Returns the exit status of CS's child, which has exited, and
+ * frees the parent's share of CS.  The caller must hold
+ * family_lock. */
+static int
+reap (struct child_status *cs) {
+	int exit_status = cs->exit_status;
+
+	ASSERT (cs->exited);
+	child_status_disown (cs);
+	return exit_status;
+}
+
+/* Threads in a process.
+ *
+ * A thread made by process_thread_create() shares the page table,
+ * supplemental page table and descriptors of the process's main
+ * thread, which keeps them until all the other threads are gone.
+ * Each gets a user stack in a slot below the area the main
+ * thread's stack may grow into; a slot is an unmapped guard page
+ * followed by THREAD_STACK_PAGES pages of stack. */
+
+/* Most threads a process may have besides its main thread, one
+ * for each bit of stack_slots. */
+#define THREAD_MAX 64
+
+/* Pages in the user stack of a thread, and bytes in a slot. */
+#define THREAD_STACK_PAGES 16
+#define THREAD_STACK_SLOT ((THREAD_STACK_PAGES + 1) * PGSIZE)
+
+/* What a thread made by process_thread_create() leaves behind for
+ * process_thread_join().  It stays on the main thread's
+ * join_records until joined or until the process exits. */
+struct join_record {
+	tid_t tid;                          /* Thread's tid, or TID_ERROR. */
+	uint64_t retval;                    /* Valid once EXITED. */
+	bool exited;                        /* Has the thread exited? */
+	bool joining;                       /* Is a thread waiting for it? */
+	struct list_elem elem;              /* In the main thread's
+	                                       join_records. */
+};
+
+/* Marks process PROC exiting, and wakes its threads that wait for
+ * a child, for another thread, on a futex, on a pipe, in poll() or
+ * for console input, so that they notice.
+ * The caller must hold family_lock. */
+static void
+begin_exit (struct thread *proc) {
+	proc->exiting = true;
+	cond_broadcast (&proc->child_exited, &family_lock);
+	cond_broadcast (&proc->thread_exited, &family_lock);
+	futex_cancel (proc);
+	pipe_cancel (proc);
+	poll_cancel (proc);
+	input_cancel (proc);
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
  * child of the calling process, or if process_wait() has already
  * been successfully called for the given TID, returns -1
- * immediately, without waiting.
- *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
+ * immediately, without waiting.  Also returns -1 if the calling
+ * process starts exiting meanwhile. */
 int
 process_wait (tid_t child_tid) {
+	struct thread *proc = thread_current ()->proc;
+	struct child_status *cs;
+	int exit_status = -1;
+
+	/* Look the record up again after each wait, in case another
+	 * thread of the process reaped it meanwhile. */
+	lock_acquire (&family_lock);
+	while ((cs = child_status_find (proc, child_tid)) != NULL
+			&& !cs->exited && !proc->exiting)
+		cond_wait (&proc->child_exited, &family_lock);
+	if (cs != NULL && cs->exited)
+		exit_status = reap (cs);
+	lock_release (&family_lock);
+	return exit_status;
+}
 
+/* Waits for any child of the calling process to die, stores its
+ * exit status in *EXIT_STATUS, and returns its tid.  Children
+ * that have already exited are reaped in the order they exited.
+ * Returns TID_ERROR immediately if the process has no children
+ * left to wait for, or once it starts exiting. */
+tid_t
+process_wait_any (int *exit_status) {
+	struct thread *proc = thread_current ()->proc;
+	tid_t tid = TID_ERROR;
+
+	lock_acquire (&family_lock);
+	while (list_empty (&proc->exited_children)
+			&& !list_empty (&proc->children) && !proc->exiting)
+		cond_wait (&proc->child_exited, &family_lock);
+	if (!list_empty (&proc->exited_children)) {
+		struct child_status *cs = list_entry (
+				list_front (&proc->exited_children), struct child_status, elem);
+
+		tid = cs->tid;
+		*exit_status = reap (cs);
+	}
+	lock_release (&family_lock);
+	return tid;
+}
 
-		struct list_elem *curr = list_begin(&thread_current()->child_list);
-		struct thread *child;
-		int exit_status = -1;
-		while (curr != list_end(&thread_current()->child_list))
-		{
-			child = list_entry(curr, struct thread, child_elem);
-			
-			if(child->tid == child_tid){
-				break;
-			}
-			curr = list_next(curr);
+/* Posts the exit status of process CURR for its parent, lets go
+ * of its own children, which become orphans, and frees the
+ * records of its threads that nobody joined. */
+static void
+post_exit_status (struct thread *curr) {
+	struct child_status *cs = curr->exit_record;
+
+	lock_acquire (&family_lock);
+	if (cs != NULL) {
+		cs->exit_status = curr->exit_status;
+		cs->exited = true;
+		if (cs->parent != NULL) {
+			list_remove (&cs->elem);
+			list_push_back (&cs->parent->exited_children, &cs->elem);
+			cond_broadcast (&cs->parent->child_exited, &family_lock);
 		}
+		child_status_release (cs);
+		curr->exit_record = NULL;
+	}
+	while (!list_empty (&curr->children))
+		child_status_disown (list_entry (list_front (&curr->children),
+					struct child_status, elem));
+	while (!list_empty (&curr->exited_children))
+		child_status_disown (list_entry (list_front (&curr->exited_children),
+					struct child_status, elem));
+	while (!list_empty (&curr->join_records))
+		free (list_entry (list_pop_front (&curr->join_records),
+					struct join_record, elem));
+	lock_release (&family_lock);
+}
 
-		if(curr == list_end(&thread_current()->child_list)){
-			for(int i = 0; i < maxet; i++){
-				if(thread_current()->est[i] != NULL && thread_current()->est[i]->tid == child_tid){
-					exit_status = thread_current()->est[i]->exit_status;
-					free(thread_current()->est[i]);
-					thread_current()->est[i] = NULL;
-					return exit_status;
-				}
-			}
-			return -1;
-		}
+/* Ends the current process with STATUS, unless another of its
+ * threads already ended it with a status of its own.  The calling
+ * thread exits at once, and the others before they next return to
+ * user mode. */
+void
+process_terminate (int status) {
+	struct thread *proc = thread_current ()->proc;
+
+	lock_acquire (&family_lock);
+	if (!proc->exiting) {
+		proc->exit_status = status;
+		proc->user_exit = true;
+		begin_exit (proc);
+	}
+	lock_release (&family_lock);
+	thread_exit ();
+}
 
-		struct semaphore sema;	
-		sema_init(&sema, 0);
-		thread_current()->wait_sema = &sema;
-		child->is_waited = true;	
-		sema_down(&sema);
-		
+/* Returns true if the calling thread is the only one in its
+ * process. */
+bool
+process_single_threaded (void) {
+	struct thread *curr = thread_current ();
+	return curr->proc == curr && curr->thread_cnt == 0;
+}
 
-		for(int i = 0; i < maxfd; i++){
-			if(thread_current()->est[i] != NULL && thread_current()->est[i]->tid == child_tid){
-				exit_status = thread_current()->est[i]->exit_status;
-				free(thread_current()->est[i]);
-				thread_current()->est[i] = NULL;
-				return exit_status;
-			}
+/* Passed from process_thread_create() to start_thread(), which
+ * frees it. */
+struct thread_args {
+	struct thread *proc;                /* Main thread of the process. */
+	struct intr_frame if_;              /* User context to start in. */
+	struct join_record *join_record;
+	int stack_slot;
+};
+
+/* Returns the lowest address of the stack in user stack slot
+ * SLOT. */
+static uint8_t *
+thread_stack_bottom (int slot) {
+#ifdef VM
+	uint64_t top = ROUND_DOWN (USER_STACK - stack_limit, PGSIZE);
+#else
+	uint64_t top = USER_STACK - PGSIZE;
+#endif
+	return (uint8_t *) (top - (uint64_t) (slot + 1) * THREAD_STACK_SLOT
+			+ PGSIZE);
+}
+
+/* Frees the first PAGE_CNT pages of the current process's user
+ * stack at BOTTOM. */
+static void
+thread_stack_free (uint8_t *bottom, int page_cnt) {
+	int i;
+#ifdef VM
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	bool locked = vm_lock ();
+
+	for (i = 0; i < page_cnt; i++) {
+		struct page *page = spt_find_page (spt, bottom + i * PGSIZE);
+
+		if (page != NULL)
+			spt_remove_page (spt, page);
+	}
+	vm_unlock (locked);
+#else
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = bottom + i * PGSIZE;
+		void *kpage = pml4_get_page (pml4, upage);
+
+		if (kpage != NULL) {
+			pml4_clear_page (pml4, upage);
+			palloc_free_page (kpage);
 		}
-		return -1;
+	}
+#endif
+}
 
+/* Gives the current process the user stack in slot SLOT, lazily
+ * allocated if there is virtual memory.  Returns false if memory
+ * runs out or something else is mapped there, leaving nothing of
+ * the stack behind. */
+static bool
+thread_stack_alloc (int slot) {
+	uint8_t *bottom = thread_stack_bottom (slot);
+	int i;
+#ifdef VM
+	bool locked = vm_lock ();
+
+	for (i = 0; i < THREAD_STACK_PAGES; i++)
+		if (!vm_alloc_page (VM_ANON | VM_STACK, bottom + i * PGSIZE, true))
+			break;
+	vm_unlock (locked);
+#else
+	for (i = 0; i < THREAD_STACK_PAGES; i++) {
+		void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
 
+		if (kpage == NULL)
+			break;
+		if (!install_page (bottom + i * PGSIZE, kpage, true)) {
+			palloc_free_page (kpage);
+			break;
+		}
+	}
+#endif
+	if (i < THREAD_STACK_PAGES) {
+		thread_stack_free (bottom, i);
+		return false;
+	}
+	return true;
 }
 
-/* Exit the process. This function is called by thread_exit (). */
-void
-process_exit (void) {
-	struct thread *curr = thread_current();
-	/* TODO: Your code goes here.
-	 * TODO: Implement process termination message (see
-	 * TODO: project2/process_termination.html).       
-	 * TODO: We recommend you to implement process resource cleanup here. */
+/* Starts a new thread in the current process, running user code
+ * at ENTRY with ARG0 and ARG1 as its first two arguments, on a
+ * stack of its own.  ENTRY must not return.  Returns the new
+ * thread's tid, or TID_ERROR if the process already has
+ * THREAD_MAX other threads or memory runs out. */
+tid_t
+process_thread_create (uint64_t entry, uint64_t arg0, uint64_t arg1) {
+	struct thread *proc = thread_current ()->proc;
+	struct join_record *record = malloc (sizeof *record);
+	struct thread_args *args = malloc (sizeof *args);
+	int slot = -1;
+	tid_t tid;
 
+	if (record == NULL || args == NULL)
+		goto error;
+	lock_acquire (&family_lock);
+	if (proc->stack_slots != UINT64_MAX) {
+		slot = __builtin_ctzll (~proc->stack_slots);
+		proc->stack_slots |= 1ULL << slot;
+	}
+	lock_release (&family_lock);
+	if (slot < 0 || !thread_stack_alloc (slot))
+		goto error;
 
-	if(curr->user_exit)
-		printf("%s: exit(%d)\n", curr->name, curr->exit_status);
-	
-	if (curr->is_waited){
-		sema_up(curr->parent->wait_sema);
+	/* Enter ENTRY as if called, with a null return address on a
+	 * stack that was 16-byte aligned before the call. */
+	init_user_frame (&args->if_);
+	args->if_.rip = entry;
+	args->if_.R.rdi = arg0;
+	args->if_.R.rsi = arg1;
+	args->if_.rsp = (uint64_t) thread_stack_bottom (slot)
+		+ THREAD_STACK_PAGES * PGSIZE - sizeof (void *);
+	args->proc = proc;
+	args->join_record = record;
+	args->stack_slot = slot;
+	record->tid = TID_ERROR;
+	record->exited = false;
+	record->joining = false;
+
+	lock_acquire (&family_lock);
+	list_push_back (&proc->join_records, &record->elem);
+	proc->thread_cnt++;
+	lock_release (&family_lock);
+
+	tid = thread_create (proc->name, PRI_DEFAULT, start_thread, args);
+
+	lock_acquire (&family_lock);
+	if (tid != TID_ERROR)
+		record->tid = tid;
+	else {
+		list_remove (&record->elem);
+		proc->thread_cnt--;
 	}
+	lock_release (&family_lock);
+	if (tid != TID_ERROR)
+		return tid;
+	thread_stack_free (thread_stack_bottom (slot), THREAD_STACK_PAGES);
 
+error:
+	if (slot >= 0) {
+		lock_acquire (&family_lock);
+		proc->stack_slots &= ~(1ULL << slot);
+		lock_release (&family_lock);
+	}
+	free (args);
+	free (record);
+	return TID_ERROR;
+}
 
-	list_remove(&curr->child_elem);
-	for(int i = 0; i < maxet; i++){
-		if(curr->parent->est[i] == NULL){
-			curr->parent->est[i] = malloc(sizeof(struct child_status));;
-			if(curr->parent->est[i] != NULL)
-			{
-				curr->parent->est[i]->exit_status = curr->exit_status;
-				curr->parent->est[i]->tid = curr->tid;
-			}
+/* A thread function that enters user mode for
+ * process_thread_create(). */
+static void
+start_thread (void *aux) {
+	struct thread_args *args = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	current->proc = args->proc;
+	current->pml4 = args->proc->pml4;
+	current->fdt = args->proc->fdt;
+	current->join_record = args->join_record;
+	current->stack_slot = args->stack_slot;
+	memcpy (&if_, &args->if_, sizeof if_);
+	free (args);
+
+	process_activate (current);
+	if (current->proc->exiting)
+		thread_exit ();
+	thread_fpu_acquire ();
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Waits for thread TID, made by process_thread_create() in the
+ * calling process, to exit, and stores the value it passed to
+ * process_thread_exit() in *RETVAL.  Returns false at once if TID
+ * is no such thread, if it is the caller, or if another thread is
+ * waiting for it already, and as soon as the process starts
+ * exiting. */
+bool
+process_thread_join (tid_t tid, uint64_t *retval) {
+	struct thread *proc = thread_current ()->proc;
+	struct join_record *record = NULL;
+	struct list_elem *e;
+	bool success = false;
+
+	if (tid == thread_tid ())
+		return false;
+	lock_acquire (&family_lock);
+	for (e = list_begin (&proc->join_records);
+			e != list_end (&proc->join_records); e = list_next (e)) {
+		struct join_record *r = list_entry (e, struct join_record, elem);
+
+		if (r->tid == tid) {
+			record = r;
 			break;
 		}
 	}
-	for(int i = 0; i < maxet; i++){
-		if(curr->est[i] != NULL){
-			free(curr->est[i]);
+	if (record != NULL && !record->joining) {
+		record->joining = true;
+		while (!record->exited && !proc->exiting)
+			cond_wait (&proc->thread_exited, &family_lock);
+		record->joining = false;
+		if (record->exited) {
+			*retval = record->retval;
+			list_remove (&record->elem);
+			free (record);
+			success = true;
 		}
 	}
+	lock_release (&family_lock);
+	return success;
+}
 
-	
+/* Ends the calling thread, leaving RETVAL for
+ * process_thread_join().  If the main thread calls this, the
+ * process lives on until its other threads have exited, and then
+ * exits with status 0. */
+void
+process_thread_exit (uint64_t retval) {
+	struct thread *curr = thread_current ();
+
+	lock_acquire (&family_lock);
+	if (curr->join_record != NULL)
+		curr->join_record->retval = retval;
+	else {
+		while (curr->thread_cnt > 0 && !curr->exiting)
+			cond_wait (&curr->thread_exited, &family_lock);
+		if (!curr->exiting) {
+			curr->exit_status = 0;
+			curr->user_exit = true;
+		}
+	}
+	lock_release (&family_lock);
+	thread_exit ();
+}
+
+/* Called by process_exit() for CURR, a thread made by
+ * process_thread_create().  Frees its user stack, leaves the
+ * process's page table before the main thread may destroy it,
+ * and lets the main thread and any joiner know. */
+static void
+exit_thread (struct thread *curr) {
+	struct thread *proc = curr->proc;
+
+	thread_stack_free (thread_stack_bottom (curr->stack_slot),
+			THREAD_STACK_PAGES);
+	curr->pml4 = NULL;
+	curr->fdt = NULL;
+	pml4_activate (NULL);
+
+	lock_acquire (&family_lock);
+	proc->stack_slots &= ~(1ULL << curr->stack_slot);
+	curr->join_record->exited = true;
+	proc->thread_cnt--;
+	cond_broadcast (&proc->thread_exited, &family_lock);
+	lock_release (&family_lock);
+}
+
+/* Exit the process. This function is called by thread_exit (). */
+void
+process_exit (void) {
+	struct thread *curr = thread_current();
+
+	/* A process killed inside a system call may still hold the lock. */
+	if (lock_held_by_current_thread (&filesys_lock))
+		lock_release (&filesys_lock);
+	uaccess_bounce_free ();
 
-	for(int i = 0; i < maxfd; i++){
-		if(curr->fdt[i] != NULL)
-			file_close(curr->fdt[i]);
+	if (curr->proc != curr) {
+		exit_thread (curr);
+		return;
 	}
+
+	/* The process's resources stay until its other threads are
+	 * gone.  They exit before they next return to user mode. */
+	lock_acquire (&family_lock);
+	if (!curr->exiting)
+		begin_exit (curr);
+	while (curr->thread_cnt > 0)
+		cond_wait (&curr->thread_exited, &family_lock);
+	lock_release (&family_lock);
+
+	if(curr->user_exit)
+		printf("%s: exit(%d)\n", curr->name, curr->exit_status);
+
+	fd_table_destroy(curr->fdt);
+	curr->fdt = NULL;
 	if (curr->exec_file != NULL) 
     	file_close(curr->exec_file);
 
 	process_cleanup ();
+	post_exit_status (curr);
 }
 
 /* Free the current process's resources. */
@@ -774,11 +1420,24 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* What lazy_load_segment() needs to fill one page of a segment. */
+struct segment_aux {
+	struct file *file;          /* Executable. */
+	off_t ofs;                  /* Offset of the page's contents in FILE. */
+	size_t read_bytes;          /* Bytes to read; the rest is zeroed. */
+};
+
 static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+lazy_load_segment (struct page *page, void *aux_) {
+	struct segment_aux *aux = aux_;
+	uint8_t *kva = page->frame->kva;
+	bool success;
+
+	success = file_read_at (aux->file, kva, aux->read_bytes, aux->ofs)
+		== (off_t) aux->read_bytes;
+	memset (kva + aux->read_bytes, 0, PGSIZE - aux->read_bytes);
+	free (aux);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -809,15 +1468,29 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
-			return false;
+		/* A page with nothing to read is zero-fill anonymous memory,
+		 * which maps the shared zero page until first written. */
+		if (page_read_bytes == 0) {
+			if (!vm_alloc_page (VM_ANON, upage, writable))
+				return false;
+		} else {
+			struct segment_aux *aux = malloc (sizeof *aux);
+			if (aux == NULL)
+				return false;
+			aux->file = file;
+			aux->ofs = ofs;
+			aux->read_bytes = page_read_bytes;
+			if (!vm_alloc_page_with_initializer (VM_ANON, upage,
+						writable, lazy_load_segment, aux)) {
+				free (aux);
+				return false;
+			}
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
+		ofs += page_read_bytes;
 		upage += PGSIZE;
 	}
 	return true;
@@ -829,11 +1502,11 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	if (vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 	return success;
 }
 #endif /* VM */
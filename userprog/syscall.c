@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <futex.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -15,32 +16,47 @@
 #include "string.h"
 #include "userprog/process.h"
 #include "threads/palloc.h"
+#include "userprog/uaccess.h"
+#include "userprog/fdtable.h"
+#include "userprog/futex.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
 
 typedef int pid_t;
+
+/* Bytes of a file name copied in from user memory, including the
+ * terminator. */
+#define NAME_BUF 128
+
+/* Most arguments spawn() passes to a program after its name. */
+#define SPAWN_ARGS_MAX 64
 struct lock filesys_lock;
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
-void halt (void);
-void exit (int status);
+void halt (void) NO_RETURN;
+void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name, struct intr_frame *f);
 int exec (const char *cmd_line);
+pid_t spawn (const char *path, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt);
 int wait (pid_t pid);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
 int open (const char *file);
-int filesize (int fd);
 int read (int fd, void *buffer, unsigned size);
 int write (int fd, const void *buffer, unsigned size);
 void seek (int fd, unsigned position);
-unsigned tell (int fd);
 void close (int fd);
-int process_add_file(struct file *f);
-struct file *process_get_file(int fd);
-void process_close_file(int fd);
-void check_ptr(const uint64_t *ptr);
+#ifdef VM
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap (void *addr);
+#endif
 
 
 /* System call.
@@ -70,220 +86,782 @@ syscall_init (void) {
 
 	
 	lock_init(&filesys_lock);
+	lock_set_name(&filesys_lock, "filesys");
+}
+
+/* System call dispatch.
+ *
+ * Each handler takes the calling thread, looked up once per call, and
+ * the interrupt frame holding the arguments in rdi, rsi, rdx, r10, r8
+ * and r9.  Its return value goes back to the user in rax. */
+typedef uint64_t syscall_func (struct thread *, struct intr_frame *);
+
+static syscall_func sys_halt, sys_exit, sys_fork, sys_exec, sys_wait;
+static syscall_func sys_create, sys_remove, sys_open, sys_filesize;
+static syscall_func sys_read, sys_write, sys_seek, sys_tell, sys_close;
+static syscall_func sys_dup2, sys_getpid, sys_wait_any, sys_spawn;
+static syscall_func sys_thread_create, sys_thread_join, sys_thread_exit;
+static syscall_func sys_futex, sys_pipe, sys_poll;
+static syscall_func sys_epoll_create, sys_epoll_ctl, sys_epoll_wait;
+#ifdef VM
+static syscall_func sys_mmap, sys_munmap;
+#endif
+
+/* Number of entries in the tables below. */
+#define SYSCALL_CNT (SYS_EPOLL_WAIT + 1)
+
+static syscall_func *const syscall_table[SYSCALL_CNT] = {
+	[SYS_HALT] = sys_halt,
+	[SYS_EXIT] = sys_exit,
+	[SYS_FORK] = sys_fork,
+	[SYS_EXEC] = sys_exec,
+	[SYS_WAIT] = sys_wait,
+	[SYS_CREATE] = sys_create,
+	[SYS_REMOVE] = sys_remove,
+	[SYS_OPEN] = sys_open,
+	[SYS_FILESIZE] = sys_filesize,
+	[SYS_READ] = sys_read,
+	[SYS_WRITE] = sys_write,
+	[SYS_SEEK] = sys_seek,
+	[SYS_TELL] = sys_tell,
+	[SYS_CLOSE] = sys_close,
+#ifdef VM
+	[SYS_MMAP] = sys_mmap,
+	[SYS_MUNMAP] = sys_munmap,
+#endif
+	[SYS_DUP2] = sys_dup2,
+	[SYS_GETPID] = sys_getpid,
+	[SYS_WAIT_ANY] = sys_wait_any,
+	[SYS_SPAWN] = sys_spawn,
+	[SYS_THREAD_CREATE] = sys_thread_create,
+	[SYS_THREAD_JOIN] = sys_thread_join,
+	[SYS_THREAD_EXIT] = sys_thread_exit,
+	[SYS_FUTEX] = sys_futex,
+	[SYS_PIPE] = sys_pipe,
+	[SYS_POLL] = sys_poll,
+	[SYS_EPOLL_CREATE] = sys_epoll_create,
+	[SYS_EPOLL_CTL] = sys_epoll_ctl,
+	[SYS_EPOLL_WAIT] = sys_epoll_wait,
+};
+
+static const char *const syscall_names[SYSCALL_CNT] = {
+	[SYS_HALT] = "halt", [SYS_EXIT] = "exit", [SYS_FORK] = "fork",
+	[SYS_EXEC] = "exec", [SYS_WAIT] = "wait", [SYS_CREATE] = "create",
+	[SYS_REMOVE] = "remove", [SYS_OPEN] = "open",
+	[SYS_FILESIZE] = "filesize", [SYS_READ] = "read",
+	[SYS_WRITE] = "write", [SYS_SEEK] = "seek", [SYS_TELL] = "tell",
+	[SYS_CLOSE] = "close", [SYS_MMAP] = "mmap", [SYS_MUNMAP] = "munmap",
+	[SYS_DUP2] = "dup2", [SYS_GETPID] = "getpid",
+	[SYS_WAIT_ANY] = "wait_any", [SYS_SPAWN] = "spawn",
+	[SYS_THREAD_CREATE] = "thread_create", [SYS_THREAD_JOIN] = "thread_join",
+	[SYS_THREAD_EXIT] = "thread_exit", [SYS_FUTEX] = "futex",
+	[SYS_PIPE] = "pipe", [SYS_POLL] = "poll",
+	[SYS_EPOLL_CREATE] = "epoll_create", [SYS_EPOLL_CTL] = "epoll_ctl",
+	[SYS_EPOLL_WAIT] = "epoll_wait",
+};
+
+/* Latency histogram buckets.  Bucket I counts calls that took
+ * fewer than 2^(I + 1) cycles; the last one takes the rest. */
+#define LATENCY_BUCKETS 32
+
+/* Per system call statistics. */
+struct syscall_stat {
+	unsigned long long cnt;             /* Calls made. */
+	unsigned long long cycles;          /* Cycles spent in calls that returned. */
+	unsigned long long latency[LATENCY_BUCKETS];
+};
+
+static struct syscall_stat syscall_stats[SYSCALL_CNT];
+
+/* Returns the latency bucket for a call that took CYCLES. */
+static int
+latency_bucket (uint64_t cycles) {
+	int bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
 }
 
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	
+syscall_handler (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
 	uint64_t number = f->R.rax;
-	switch (number)
-	{
-	case SYS_HALT:
-		halt();
-		break;
-	case SYS_EXIT:
-		exit(f->R.rdi);
-		break;
-	case SYS_FORK:
-		f->R.rax = fork(f->R.rdi, f);
-		break;
-	case SYS_EXEC:
-		f->R.rax = exec(f->R.rdi);
-		break;
-	case SYS_WAIT:
-		f->R.rax = wait(f->R.rdi);
-		break;
-	case SYS_CREATE:
-		f->R.rax = create(f->R.rdi, f->R.rsi);
-		lock_release(&filesys_lock);
-		break;
-	case SYS_REMOVE:
-		f->R.rax = remove(f->R.rdi);
-		lock_release(&filesys_lock);
-		break;
-	case SYS_OPEN:
-		f->R.rax = open(f->R.rdi);
-		lock_release(&filesys_lock);
-
-		break;
-	case SYS_FILESIZE:
-		f->R.rax = filesize(f->R.rdi);
-		break;
-	case SYS_READ:
-		f->R.rax = read(f->R.rdi, f->R.rsi, f->R.rdx);
-		lock_release(&filesys_lock);
-		break;
-	case SYS_WRITE:
-		f->R.rax = write(f->R.rdi, f->R.rsi, f->R.rdx);
-		lock_release(&filesys_lock);
-		break;
-	case SYS_SEEK:
-		seek(f->R.rdi, f->R.rsi);
-		break;
-	case SYS_TELL:
-		f->R.rax = tell(f->R.rdi);
-		break;
-	case SYS_CLOSE:
-		close(f->R.rdi);
-		break;
-	default:
-		break;
+	struct syscall_stat *stat;
+	uint64_t start, cycles;
+
+	if (number >= SYSCALL_CNT || syscall_table[number] == NULL)
+		return;
+#ifdef VM
+	/* Page faults taken in the kernel need this to tell stack growth. */
+	curr->user_rsp = (void *) f->rsp;
+#endif
+
+	/* Calls that do not return, like exit, are counted but not timed. */
+	stat = &syscall_stats[number];
+	stat->cnt++;
+	start = rdtsc ();
+	f->R.rax = syscall_table[number] (curr, f);
+	cycles = rdtsc () - start;
+	stat->cycles += cycles;
+	stat->latency[latency_bucket (cycles)]++;
+
+	/* Another thread may have ended the process meanwhile. */
+	if (curr->proc->exiting)
+		thread_exit ();
+}
+
+/* Prints system call statistics. */
+void
+syscall_print_stats (void) {
+	int i, b;
+
+	for (i = 0; i < SYSCALL_CNT; i++) {
+		const struct syscall_stat *stat = &syscall_stats[i];
+		unsigned long long timed = 0;
+
+		if (stat->cnt == 0)
+			continue;
+		for (b = 0; b < LATENCY_BUCKETS; b++)
+			timed += stat->latency[b];
+		printf ("Syscall: %s: %llu calls, %llu cycles on average;",
+				syscall_names[i], stat->cnt,
+				timed != 0 ? stat->cycles / timed : 0);
+		for (b = 0; b < LATENCY_BUCKETS; b++)
+			if (stat->latency[b] != 0)
+				printf (" <2^%d: %llu", b + 1, stat->latency[b]);
+		printf ("\n");
+	}
+}
+
+static uint64_t
+sys_halt (struct thread *curr UNUSED, struct intr_frame *f UNUSED) {
+	halt ();
+}
+
+static uint64_t
+sys_exit (struct thread *curr UNUSED, struct intr_frame *f) {
+	exit (f->R.rdi);
+}
+
+static uint64_t
+sys_fork (struct thread *curr UNUSED, struct intr_frame *f) {
+	return fork ((const char *) f->R.rdi, f);
+}
+
+static uint64_t
+sys_exec (struct thread *curr UNUSED, struct intr_frame *f) {
+	return exec ((const char *) f->R.rdi);
+}
+
+static uint64_t
+sys_spawn (struct thread *curr UNUSED, struct intr_frame *f) {
+	return spawn ((const char *) f->R.rdi, (char *const *) f->R.rsi,
+			(const struct spawn_action *) f->R.rdx, f->R.r10);
+}
+
+static uint64_t
+sys_wait (struct thread *curr UNUSED, struct intr_frame *f) {
+	return wait (f->R.rdi);
+}
+
+static uint64_t
+sys_create (struct thread *curr UNUSED, struct intr_frame *f) {
+	return create ((const char *) f->R.rdi, f->R.rsi);
+}
+
+static uint64_t
+sys_remove (struct thread *curr UNUSED, struct intr_frame *f) {
+	return remove ((const char *) f->R.rdi);
+}
+
+static uint64_t
+sys_open (struct thread *curr UNUSED, struct intr_frame *f) {
+	return open ((const char *) f->R.rdi);
+}
+
+static uint64_t
+sys_read (struct thread *curr UNUSED, struct intr_frame *f) {
+	return read (f->R.rdi, (void *) f->R.rsi, f->R.rdx);
+}
+
+static uint64_t
+sys_write (struct thread *curr UNUSED, struct intr_frame *f) {
+	return write (f->R.rdi, (const void *) f->R.rsi, f->R.rdx);
+}
+
+static uint64_t
+sys_seek (struct thread *curr UNUSED, struct intr_frame *f) {
+	seek (f->R.rdi, f->R.rsi);
+	return 0;
+}
+
+static uint64_t
+sys_close (struct thread *curr UNUSED, struct intr_frame *f) {
+	close (f->R.rdi);
+	return 0;
+}
+
+static uint64_t
+sys_dup2 (struct thread *curr, struct intr_frame *f) {
+	return fd_dup2 (curr->fdt, f->R.rdi, f->R.rsi);
+}
+
+/* Returns CURR's open file FD, or a null pointer if FD is not open
+ * or refers to the console.  A file returned must be passed to
+ * fd_put() when done with. */
+static struct file *
+fd_lookup (struct thread *curr, int fd) {
+	struct file *file = fd_get (curr->fdt, fd);
+	return fd_is_console (file) ? NULL : file;
+}
+
+/* filesize, tell and getpid read only the caller's own state, so
+ * they take no file system locks, and fd_get() takes no descriptor
+ * table lock either. */
+
+static uint64_t
+sys_filesize (struct thread *curr, struct intr_frame *f) {
+	struct file *file = fd_lookup (curr, f->R.rdi);
+	off_t length;
+
+	if (file == NULL)
+		return -1;
+	length = file_length (file);
+	fd_put (curr->fdt, file);
+	return length;
+}
+
+static uint64_t
+sys_tell (struct thread *curr, struct intr_frame *f) {
+	struct file *file = fd_lookup (curr, f->R.rdi);
+	off_t pos;
+
+	if (file == NULL)
+		return -1;
+	pos = file_tell (file);
+	fd_put (curr->fdt, file);
+	return pos;
+}
+
+static uint64_t
+sys_getpid (struct thread *curr, struct intr_frame *f UNUSED) {
+	return curr->proc->tid;
+}
+
+/* The status pointer is checked by writing to it before waiting,
+ * so that a bad one cannot make the child's status disappear. */
+static uint64_t
+sys_wait_any (struct thread *curr UNUSED, struct intr_frame *f) {
+	int *ustatus = (int *) f->R.rdi;
+	int status = -1;
+	tid_t tid;
+
+	if (ustatus != NULL && !copy_to_user (ustatus, &status, sizeof status))
+		exit (-1);
+	tid = process_wait_any (&status);
+	if (tid != TID_ERROR && ustatus != NULL
+			&& !copy_to_user (ustatus, &status, sizeof status))
+		exit (-1);
+	return tid;
+}
+
+static uint64_t
+sys_thread_create (struct thread *curr UNUSED, struct intr_frame *f) {
+	return process_thread_create (f->R.rdi, f->R.rsi, f->R.rdx);
+}
+
+/* Like wait_any, checks the return value pointer before waiting,
+ * since the joined thread's record is gone afterward. */
+static uint64_t
+sys_thread_join (struct thread *curr UNUSED, struct intr_frame *f) {
+	uint64_t *uretval = (uint64_t *) f->R.rsi;
+	uint64_t retval = 0;
+
+	if (uretval != NULL && !copy_to_user (uretval, &retval, sizeof retval))
+		exit (-1);
+	if (!process_thread_join (f->R.rdi, &retval))
+		return -1;
+	if (uretval != NULL && !copy_to_user (uretval, &retval, sizeof retval))
+		exit (-1);
+	return 0;
+}
+
+static uint64_t
+sys_thread_exit (struct thread *curr UNUSED, struct intr_frame *f) {
+	process_thread_exit (f->R.rdi);
+}
+
+static uint64_t
+sys_futex (struct thread *curr UNUSED, struct intr_frame *f) {
+	int *uaddr = (int *) f->R.rdi;
+
+	switch (f->R.rsi) {
+		case FUTEX_WAIT:
+			return futex_wait (uaddr, f->R.rdx, (int64_t) f->R.r10);
+		case FUTEX_WAKE:
+			return futex_wake (uaddr, f->R.rdx);
+		default:
+			return -1;
 	}
 }
 
+/* The descriptor array is checked by writing to it before the
+ * pipe is made, so that a bad one cannot leave both ends open. */
+static uint64_t
+sys_pipe (struct thread *curr, struct intr_frame *f) {
+	int *ufds = (int *) f->R.rdi;
+	int fds[2] = { -1, -1 };
+	struct pipe *p;
+	struct file *ends[2];
+
+	if (!copy_to_user (ufds, fds, sizeof fds))
+		exit (-1);
+	p = pipe_create ();
+	if (p == NULL)
+		return -1;
+	pipe_open_end (p, false);
+	pipe_open_end (p, true);
+	ends[0] = file_open_pipe (p, false);
+	ends[1] = file_open_pipe (p, true);
+	if (ends[0] != NULL)
+		fds[0] = fd_install (curr->fdt, ends[0]);
+	if (ends[1] != NULL)
+		fds[1] = fd_install (curr->fdt, ends[1]);
+
+	/* Drop the creator's references; the files now hold their own. */
+	pipe_close_end (p, false);
+	pipe_close_end (p, true);
+	if (fds[0] < 0 || fds[1] < 0) {
+		if (fds[0] >= 0)
+			fd_close (curr->fdt, fds[0]);
+		else
+			file_close (ends[0]);
+		if (fds[1] >= 0)
+			fd_close (curr->fdt, fds[1]);
+		else
+			file_close (ends[1]);
+		return -1;
+	}
+	if (!copy_to_user (ufds, fds, sizeof fds))
+		exit (-1);
+	return 0;
+}
+
+static uint64_t
+sys_poll (struct thread *curr UNUSED, struct intr_frame *f) {
+	int ready = poll_fds ((struct pollfd *) f->R.rdi, f->R.rsi,
+			(int) f->R.rdx);
+
+	if (ready == POLL_FAULT)
+		exit (-1);
+	return ready;
+}
+
+static uint64_t
+sys_epoll_create (struct thread *curr, struct intr_frame *f UNUSED) {
+	struct epoll *ep = epoll_create ();
+	struct file *file;
+	int fd;
+
+	if (ep == NULL)
+		return -1;
+	file = file_open_epoll (ep);
+	if (file == NULL)
+		return -1;
+	fd = fd_install (curr->fdt, file);
+	if (fd < 0)
+		file_close (file);
+	return fd;
+}
+
+/* Returns CURR's interest set EPFD with a reference taken by
+ * fd_get() in *FILE, or a null pointer if EPFD is not one. */
+static struct epoll *
+epoll_lookup (struct thread *curr, int epfd, struct file **file) {
+	struct epoll *ep;
+
+	*file = fd_lookup (curr, epfd);
+	if (*file == NULL)
+		return NULL;
+	ep = file_get_epoll (*file);
+	if (ep == NULL)
+		fd_put (curr->fdt, *file);
+	return ep;
+}
+
+static uint64_t
+sys_epoll_ctl (struct thread *curr, struct intr_frame *f) {
+	const struct epoll_event *uevent = (const struct epoll_event *) f->R.r10;
+	struct file *epfile, *file;
+	struct epoll_event event;
+	struct epoll *ep;
+	int result = -1;
+
+	if (f->R.rsi != EPOLL_CTL_DEL
+			&& !copy_from_user (&event, uevent, sizeof event))
+		exit (-1);
+	ep = epoll_lookup (curr, f->R.rdi, &epfile);
+	if (ep == NULL)
+		return -1;
+	/* An item is removed by descriptor number, which may have been
+	 * closed since it was added. */
+	if (f->R.rsi == EPOLL_CTL_DEL)
+		result = epoll_ctl (ep, f->R.rsi, f->R.rdx, NULL, NULL);
+	else if ((file = fd_get (curr->fdt, f->R.rdx)) != NULL) {
+		result = epoll_ctl (ep, f->R.rsi, f->R.rdx, file, &event);
+		fd_put (curr->fdt, file);
+	}
+	fd_put (curr->fdt, epfile);
+	return result;
+}
+
+static uint64_t
+sys_epoll_wait (struct thread *curr, struct intr_frame *f) {
+	struct file *epfile;
+	struct epoll *ep = epoll_lookup (curr, f->R.rdi, &epfile);
+	int cnt;
+
+	if (ep == NULL)
+		return -1;
+	cnt = epoll_wait (ep, (struct epoll_event *) f->R.rsi, f->R.rdx,
+			(int) f->R.r10);
+	fd_put (curr->fdt, epfile);
+	if (cnt == POLL_FAULT)
+		exit (-1);
+	return cnt;
+}
+
+#ifdef VM
+static uint64_t
+sys_mmap (struct thread *curr UNUSED, struct intr_frame *f) {
+	return (uint64_t) mmap ((void *) f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10,
+			f->R.r8);
+}
+
+static uint64_t
+sys_munmap (struct thread *curr UNUSED, struct intr_frame *f) {
+	munmap ((void *) f->R.rdi);
+	return 0;
+}
+#endif
+
 void halt (void){
 	power_off();
 }
 void exit (int status){
-	thread_current()->exit_status = status;
-	thread_current()->user_exit = true;
-	thread_exit();
+	process_terminate(status);
 }
 
 pid_t fork (const char *thread_name, struct intr_frame *f){
-	return process_fork(thread_name, f);
+	char name[16];
+
+	if(strncpy_from_user(name, thread_name, sizeof name) < 0)
+		exit(-1);
+	name[sizeof name - 1] = '\0';
+	return process_fork(name, f);
 }
 
 int exec(const char *cmd_line){
-	check_ptr(cmd_line);
+	char *fn_copy = palloc_get_page(0);
+	if(fn_copy == NULL) return -1;
+	if(strncpy_from_user(fn_copy, cmd_line, PGSIZE) < 0) {
+		palloc_free_page(fn_copy);
+		exit(-1);
+	}
+	fn_copy[PGSIZE - 1] = '\0';
+
+	/* The other threads would be left running the old program. */
+	if(!process_single_threaded()) {
+		palloc_free_page(fn_copy);
+		return -1;
+	}
 	if(thread_current()->exec_file != NULL) {
 		file_close(thread_current()->exec_file);
 		thread_current()->exec_file = NULL;
 	}
-
-	char *fn_copy = palloc_get_page(0);
-	if(fn_copy == NULL) return -1;
-	strlcpy(fn_copy, cmd_line, PGSIZE);
-	
 	if (process_exec(fn_copy) == -1) {
 		exit(-1);
 	}	
 	return -1;
 }
 
+/* Builds a command line for process_spawn() in CMD_LINE, a page:
+ * PATH, then ARGV[1] onward, separated by spaces.  ARGV may be a
+ * null pointer.  Returns the command line's length, 0 if an
+ * argument is empty or holds a space, which the loader could not
+ * pass on, or if they do not fit, or -1 for a bad pointer. */
+static long
+build_cmd_line (char *cmd_line, const char *path, char *const argv[]) {
+	long len = strncpy_from_user(cmd_line, path, PGSIZE);
+	int i;
+
+	if(len <= 0)
+		return len;
+	if(len >= PGSIZE || strchr(cmd_line, ' ') != NULL)
+		return 0;
+	for(i = 1; argv != NULL; i++){
+		const char *uarg;
+		long n;
+
+		if(!copy_from_user(&uarg, &argv[i], sizeof uarg))
+			return -1;
+		if(uarg == NULL)
+			break;
+		if(i > SPAWN_ARGS_MAX || len + 1 >= PGSIZE)
+			return 0;
+		cmd_line[len++] = ' ';
+		n = strncpy_from_user(cmd_line + len, uarg, PGSIZE - len);
+		if(n < 0)
+			return -1;
+		if(n == 0 || len + n >= PGSIZE || strchr(cmd_line + len, ' ') != NULL)
+			return 0;
+		len += n;
+	}
+	return len;
+}
+
+pid_t spawn (const char *path, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt){
+	struct spawn_action kactions[SPAWN_ACTIONS_MAX];
+	char *cmd_line;
+	long len;
+	pid_t pid;
+
+	if(action_cnt > SPAWN_ACTIONS_MAX)
+		return -1;
+	if(action_cnt > 0
+			&& !copy_from_user(kactions, actions, action_cnt * sizeof *kactions))
+		exit(-1);
+
+	cmd_line = palloc_get_page(0);
+	if(cmd_line == NULL)
+		return -1;
+	len = build_cmd_line(cmd_line, path, argv);
+	if(len < 0){
+		palloc_free_page(cmd_line);
+		exit(-1);
+	}
+	pid = len > 0 ? process_spawn(cmd_line, kactions, action_cnt) : -1;
+	palloc_free_page(cmd_line);
+	return pid;
+}
+
 int wait (pid_t pid){
 	return process_wait(pid);
 }
 
+/* Copies the file name at user address UNAME into NAME, which holds
+ * NAME_BUF bytes.  Kills the process if UNAME is a bad pointer.
+ * Returns false if the name is empty or does not fit. */
+static bool
+get_file_name (char name[NAME_BUF], const char *uname) {
+	long len = strncpy_from_user(name, uname, NAME_BUF);
+
+	if(len < 0)
+		exit(-1);
+	return 0 < len && len < NAME_BUF;
+}
+
 bool create (const char *file, unsigned initial_size){
-	check_ptr(file);
-	
+	char name[NAME_BUF];
+	bool success;
+
+	if(!get_file_name(name, file) || strlen(name) > 16)
+		return false;
 	lock_acquire(&filesys_lock);
-	
-	if(file[0] == '\0'|| file == NULL || strlen(file) > 16 || initial_size < 0)return 0;
-	return filesys_create(file, initial_size);
+	success = filesys_create(name, initial_size);
+	lock_release(&filesys_lock);
+	return success;
 }
 
 bool remove (const char *file){	
-	check_ptr(file);
-	
-	lock_acquire(&filesys_lock);
+	char name[NAME_BUF];
+	bool success;
 
-	return filesys_remove(file);
+	if(!get_file_name(name, file))
+		return false;
+	lock_acquire(&filesys_lock);
+	success = filesys_remove(name);
+	lock_release(&filesys_lock);
+	return success;
 }
 
 int open (const char *file){
-	check_ptr(file);
-	
+	char name[NAME_BUF];
+	struct file *f;
+	int fd;
+
+	if(!get_file_name(name, file))
+		return -1;
 	lock_acquire(&filesys_lock);
-	if(file[0] == '\0' || file == NULL)return -1;
-	
-	struct file *f = filesys_open(file);
+	f = filesys_open(name);
+	lock_release(&filesys_lock);
 
 	if(f == NULL) return -1;
-	int fd = process_add_file(f);
+	fd = fd_install(thread_current()->fdt, f);
 	if(fd == -1)
 		file_close(f);
 	return fd;
 }
 
-int filesize (int fd){
-	return file_length(thread_current()->fdt[fd]);
+/* read() and write() move data through a kernel page, a page at a
+ * time, so that a bad user buffer faults in copy_to_user() or
+ * copy_from_user() and never inside the file system.  The page is
+ * the one each thread keeps for this, from uaccess_bounce_get(), so
+ * most calls allocate nothing.  Pipes use it too, in pipe_read()
+ * and pipe_write(), and take no filesys_lock.  Reading the console
+ * waits only until some input is typed, and returns what is
+ * there. */
+
+/* Reads (or, if WRITE, writes) SIZE bytes of BUFFER through pipe
+ * end F, and drops the caller's reference to F.  Using the wrong
+ * end fails. */
+static int pipe_rw (struct file *f, void *buffer, unsigned size, bool write){
+	bool writer;
+	struct pipe *p = file_get_pipe(f, &writer);
+	int bytes;
+
+	if(writer != write)
+		bytes = -1;
+	else if(write)
+		bytes = pipe_write(p, buffer, size);
+	else
+		bytes = pipe_read(p, buffer, size);
+	fd_put(thread_current()->fdt, f);
+	if(bytes == PIPE_FAULT)
+		exit(-1);
+	return bytes;
 }
 
 int read (int fd, void *buffer, unsigned size){
-	
-	check_ptr(buffer);
-	lock_acquire(&filesys_lock);
+	uint8_t *bounce;
+	struct file *f = fd_get(thread_current()->fdt, fd);
+	unsigned total = 0;
+	bool writer;
+
+	if(f == NULL)
+		return 0;
+	if(f == FD_CONSOLE_OUT || size == 0){
+		fd_put(thread_current()->fdt, f);
+		return 0;
+	}
+	if(f != FD_CONSOLE_IN && file_get_pipe(f, &writer) != NULL)
+		return pipe_rw(f, buffer, size, false);
+	if(f != FD_CONSOLE_IN && file_get_epoll(f) != NULL){
+		fd_put(thread_current()->fdt, f);
+		return -1;
+	}
+	bounce = uaccess_bounce_get();
+	if(bounce == NULL){
+		fd_put(thread_current()->fdt, f);
+		return -1;
+	}
 
+	while(total < size){
+		unsigned chunk = size - total < PGSIZE ? size - total : PGSIZE;
+		int bytes;
 
-	if(!(0 <= fd && fd < maxfd) || (fd != 0 && process_get_file(fd) == NULL)) return 0;
-	
-	struct file* f = process_get_file(fd);
-	if(fd == 0){
-		for(int i = 0; i < size; i++){
-			((char *)buffer)[i] = input_getc();
-		}	
-		return size;
-	}
-	else{	
-		return file_read(f, buffer, size);
+		if(f == FD_CONSOLE_IN)
+			bytes = input_read(bounce, chunk);
+		else{
+			lock_acquire(&filesys_lock);
+			bytes = file_read(f, bounce, chunk);
+			lock_release(&filesys_lock);
+		}
+		if(bytes > 0 && !copy_to_user((uint8_t *) buffer + total, bounce, bytes)){
+			uaccess_bounce_put(bounce);
+			fd_put(thread_current()->fdt, f);
+			exit(-1);
+		}
+		if(bytes <= 0)
+			break;
+		total += bytes;
+		if((unsigned) bytes < chunk || f == FD_CONSOLE_IN)
+			break;
 	}
+	uaccess_bounce_put(bounce);
+	fd_put(thread_current()->fdt, f);
+	return total;
 }
 
 int write (int fd, const void *buffer, unsigned size){
-	check_ptr(buffer);
-
-	lock_acquire(&filesys_lock);
-	
-	
-	
-	if(!(0 <= fd && fd < maxfd) || (fd != 1 && process_get_file(fd) == NULL)) return 0;
-	
+	uint8_t *bounce;
+	struct file *f = fd_get(thread_current()->fdt, fd);
+	unsigned total = 0;
+	bool writer;
+
+	if(f == NULL)
+		return 0;
+	if(f == FD_CONSOLE_IN || size == 0){
+		fd_put(thread_current()->fdt, f);
+		return 0;
+	}
+	if(f != FD_CONSOLE_OUT && file_get_pipe(f, &writer) != NULL)
+		return pipe_rw(f, (void *) buffer, size, true);
+	if(f != FD_CONSOLE_OUT && file_get_epoll(f) != NULL){
+		fd_put(thread_current()->fdt, f);
+		return -1;
+	}
+	bounce = uaccess_bounce_get();
+	if(bounce == NULL){
+		fd_put(thread_current()->fdt, f);
+		return -1;
+	}
 
+	while(total < size){
+		unsigned chunk = size - total < PGSIZE ? size - total : PGSIZE;
+		int bytes;
 
-	if(fd == 1){
-		putbuf(buffer, size);
-		return size;
-	}
-	else{	
-		struct file* f = process_get_file(fd);
-		return file_write(f, buffer, size);
+		if(!copy_from_user(bounce, (const uint8_t *) buffer + total, chunk)){
+			uaccess_bounce_put(bounce);
+			fd_put(thread_current()->fdt, f);
+			exit(-1);
+		}
+		if(f == FD_CONSOLE_OUT){
+			putbuf((const char *) bounce, chunk);
+			bytes = chunk;
+		}
+		else{
+			lock_acquire(&filesys_lock);
+			bytes = file_write(f, bounce, chunk);
+			lock_release(&filesys_lock);
+		}
+		if(bytes <= 0)
+			break;
+		total += bytes;
+		if((unsigned) bytes < chunk)
+			break;
 	}
+	uaccess_bounce_put(bounce);
+	fd_put(thread_current()->fdt, f);
+	return total;
 }
 
 void seek (int fd, unsigned position){
-	struct file *f = process_get_file(fd);
-	file_seek(f, position);
-}
-
-unsigned tell (int fd){
-	struct file *f = process_get_file(fd);
-	return file_tell(f);
+	struct file *f = fd_lookup(thread_current(), fd);
+	if(f != NULL){
+		file_seek(f, position);
+		fd_put(thread_current()->fdt, f);
+	}
 }
 
+/* Closing a descriptor that is not open does nothing. */
 void close (int fd){
-	if(2 < fd && fd <= maxfd)
-		process_close_file(fd);
-	else
-		exit(-1);
+	fd_close(thread_current()->fdt, fd);
 }
 
-int process_add_file(struct file *f){
-	int fd = -1;
-	for(int i = 3; i < maxfd; i++){
-		if(thread_current()->fdt[i] == NULL){
-			fd = i;
-			thread_current()->fdt[fd] = f;
-			break;
-		}
-	}
-	return fd;
-}
+#ifdef VM
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset){
+	struct file *f = fd_lookup(thread_current(), fd);
+	void *result;
 
-struct file *process_get_file(int fd){
-	return thread_current()->fdt[fd];
+	if(f == NULL)
+		return NULL;
+	result = do_mmap(addr, length, writable, f, offset);
+	fd_put(thread_current()->fdt, f);
+	return result;
 }
 
-void process_close_file(int fd){
-	struct file *f = process_get_file(fd);
-	if(f != NULL)
-		file_close(f);
-	thread_current()->fdt[fd] = NULL;
+void munmap (void *addr){
+	do_munmap(addr);
 }
-
-void check_ptr(const uint64_t *ptr){
-	if(ptr == NULL ||  !is_user_vaddr(ptr) || pml4_get_page(thread_current()->pml4, ptr) == NULL)
-		exit(-1);
-}
\ No newline at end of file
+#endif
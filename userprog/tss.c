@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include "userprog/gdt.h"
 #include "threads/thread.h"
+#include "threads/kstack.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
@@ -48,6 +49,12 @@
 /* Kernel TSS. */
 struct task_state *tss;
 
+/* Stack for double faults, which arrive on it through IST slot
+ * TSS_IST_DOUBLE_FAULT whatever the stack pointer was.  A kernel
+ * stack overflow ends in a double fault, and the stack that
+ * overflowed cannot take the handler's frame. */
+static uint8_t double_fault_stack[PGSIZE] __attribute__ ((aligned (16)));
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) {
@@ -55,6 +62,7 @@ tss_init (void) {
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
 	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	tss->ist1 = (uint64_t) double_fault_stack + sizeof double_fault_stack;
 	tss_update (thread_current ());
 }
 
@@ -70,5 +78,8 @@ tss_get (void) {
 void
 tss_update (struct thread *next) {
 	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	if (next->kstack != NULL)
+		tss->rsp0 = (uint64_t) next->kstack + KSTACK_SIZE;
+	else
+		tss->rsp0 = (uint64_t) next + PGSIZE;
 }
@@ -0,0 +1,126 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* An entry in the exception table: if the instruction at INSN
+   faults, resume at FIXUP. */
+struct exception_fixup {
+	uintptr_t insn;
+	uintptr_t fixup;
+};
+
+/* Bounds of the exception table, from the linker script. */
+extern const struct exception_fixup __start_ex_table[], __stop_ex_table[];
+
+/* In uaccess-copy.S. */
+size_t uaccess_copy (void *dst, const void *src, size_t size);
+long uaccess_strncpy (char *dst, const char *src, size_t size);
+
+/* Returns true if the SIZE bytes at UADDR all lie in user memory. */
+static bool
+user_range_ok (const void *uaddr, size_t size) {
+	uintptr_t start = (uintptr_t) uaddr;
+	return start != 0 && start < KERN_BASE && size <= KERN_BASE - start;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if USRC is bad. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	ASSERT (dst != NULL || size == 0);
+
+	if (!user_range_ok (usrc, size))
+		return false;
+	return uaccess_copy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if UDST is bad or read-only.  Bytes before
+   the bad one may have been written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	ASSERT (src != NULL || size == 0);
+
+	if (!user_range_ok (udst, size))
+		return false;
+	return uaccess_copy (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which holds SIZE bytes.  Returns the length of the string,
+   not counting the terminator.  If the first SIZE bytes hold no
+   terminator, returns SIZE, and DST is not terminated.  Returns -1
+   if USRC is bad. */
+long
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	uintptr_t start = (uintptr_t) usrc;
+
+	ASSERT (dst != NULL || size == 0);
+
+	if (start == 0 || start >= KERN_BASE)
+		return -1;
+
+	/* Stop at the top of user memory; running into it without a
+	   terminator is as bad as faulting. */
+	if (size > KERN_BASE - start) {
+		long len = uaccess_strncpy (dst, usrc, KERN_BASE - start);
+		return len == (long) (KERN_BASE - start) ? -1 : len;
+	}
+	return uaccess_strncpy (dst, usrc, size);
+}
+
+/* Returns a page for the current thread to copy user data
+   through, or a null pointer if out of memory.  Each thread keeps
+   the page it last gave back, so that most calls allocate
+   nothing.  The caller gives the page back, or one it traded it
+   for, with uaccess_bounce_put(). */
+void *
+uaccess_bounce_get (void) {
+	struct thread *curr = thread_current ();
+	void *page = curr->bounce_page;
+
+	if (page == NULL)
+		return palloc_get_page (0);
+	curr->bounce_page = NULL;
+	return page;
+}
+
+/* Gives back PAGE, which may be null, for the current thread's
+   next call to uaccess_bounce_get(). */
+void
+uaccess_bounce_put (void *page) {
+	struct thread *curr = thread_current ();
+
+	if (curr->bounce_page == NULL)
+		curr->bounce_page = page;
+	else
+		palloc_free_page (page);
+}
+
+/* Frees the page the current thread kept, as it exits. */
+void
+uaccess_bounce_free (void) {
+	struct thread *curr = thread_current ();
+
+	palloc_free_page (curr->bounce_page);
+	curr->bounce_page = NULL;
+}
+
+/* Called for a page fault in the kernel that could not be
+   resolved.  If it came from one of the accessors above, points F
+   at the accessor's fixup and returns true.  Otherwise, returns
+   false. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct exception_fixup *e;
+
+	for (e = __start_ex_table; e < __stop_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
@@ -1,6 +1,12 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <hash.h>
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -14,45 +20,349 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* A resident page of a mapped file.  Every mapping of the same file range,
+ * in any process, is backed by this one frame while it stays resident. */
+struct shared_page {
+	struct inode *inode;        /* File. */
+	off_t ofs;                  /* Page offset within the file. */
+	struct frame *frame;        /* Frame holding the contents. */
+	struct hash_elem elem;      /* Element in shared_pages. */
+};
+
+/* Resident shared_pages, keyed by (inode, ofs). */
+static struct hash shared_pages;
+
+static uint64_t
+shared_page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct shared_page *sp = hash_entry (e, struct shared_page, elem);
+	return hash_bytes (&sp->inode, sizeof sp->inode) ^ hash_int (sp->ofs);
+}
+
+static bool
+shared_page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct shared_page *a = hash_entry (a_, struct shared_page, elem);
+	const struct shared_page *b = hash_entry (b_, struct shared_page, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
+
+/* Returns the file_page describing PAGE, which may still be uninit, in which
+ * case the description is the pending initializer's AUX. */
+static struct file_page *
+file_page_of (struct page *page) {
+	ASSERT (page_get_type (page) == VM_FILE);
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		return page->uninit.aux;
+	return &page->file;
+}
+
+/* Returns the shared_page entry for the range FILE_PAGE maps, or NULL. */
+static struct shared_page *
+shared_page_find (const struct file_page *file_page) {
+	struct shared_page key;
+	struct hash_elem *e;
+
+	key.inode = file_get_inode (file_page->file);
+	key.ofs = file_page->ofs;
+	e = hash_find (&shared_pages, &key.elem);
+	return e != NULL ? hash_entry (e, struct shared_page, elem) : NULL;
+}
+
+/* Publishes FRAME as the resident copy of the range FILE_PAGE maps.  Failing
+ * to allocate only costs us the sharing. */
+static void
+shared_page_insert (const struct file_page *file_page, struct frame *frame) {
+	struct shared_page *sp = malloc (sizeof *sp);
+
+	if (sp == NULL)
+		return;
+	sp->inode = file_get_inode (file_page->file);
+	sp->ofs = file_page->ofs;
+	sp->frame = frame;
+	if (hash_insert (&shared_pages, &sp->elem) != NULL)
+		free (sp);
+}
+
+/* Withdraws the range FILE_PAGE maps from sharing. */
+static void
+shared_page_remove (const struct file_page *file_page) {
+	struct shared_page *sp = shared_page_find (file_page);
+
+	if (sp != NULL) {
+		hash_delete (&shared_pages, &sp->elem);
+		free (sp);
+	}
+}
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	hash_init (&shared_pages, shared_page_hash, shared_page_less, NULL);
 }
 
 /* Initialize the file backed page */
 bool
 file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+	struct file_page *aux = page->uninit.aux;
+
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	*file_page = *aux;
+	free (aux);
+	return file_backed_swap_in (page, kva);
+}
+
+/* Returns the frame already holding the file range PAGE maps, if another
+ * mapping brought it in, or NULL. */
+struct frame *
+file_backed_lookup (struct page *page) {
+	struct shared_page *sp = shared_page_find (file_page_of (page));
+	return sp != NULL ? sp->frame : NULL;
+}
+
+/* Returns the access stream of the region PAGE belongs to. */
+struct fault_stream *
+file_backed_stream (struct page *page) {
+	return &file_page_of (page)->map->stream;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	/* Joining a frame another mapping filled: contents are already there. */
+	if (page->frame->page != page)
+		return true;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->ofs) != (off_t) file_page->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + file_page->read_bytes, 0,
+			PGSIZE - file_page->read_bytes);
+	shared_page_insert (file_page, page->frame);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+	bool dirty = false;
+	struct list_elem *e;
+
+	/* Only write back if some mapping actually modified the frame. */
+	for (e = list_begin (&frame->mappers); e != list_end (&frame->mappers);
+			e = list_next (e)) {
+		struct page *mapper = list_entry (e, struct page, frame_elem);
+		dirty |= pml4_is_dirty (mapper->owner->pml4, mapper->va);
+	}
+	if (dirty && file_write_at (file_page->file, frame->kva,
+				file_page->read_bytes, file_page->ofs)
+			!= (off_t) file_page->read_bytes)
+		return false;
+
+	shared_page_remove (file_page);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+
+	if (frame == NULL)
+		return;
+
+	/* Clean pages are already identical to the file. */
+	if (pml4_is_dirty (page->owner->pml4, page->va))
+		file_write_at (file_page->file, frame->kva, file_page->read_bytes,
+				file_page->ofs);
+	if (list_size (&frame->mappers) == 1)
+		shared_page_remove (file_page);
+	vm_frame_unlink (page);
+}
+
+/* Returns SPT's region that starts at ADDR, or NULL. */
+static struct mmap_file *
+find_mmap (struct supplemental_page_table *spt, void *addr) {
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->mmaps); e != list_end (&spt->mmaps);
+			e = list_next (e)) {
+		struct mmap_file *map = list_entry (e, struct mmap_file, elem);
+		if (map->addr == addr)
+			return map;
+	}
+	return NULL;
+}
+
+/* Adds the pages of MAP to the current thread's SPT, each mapping the
+ * PGSIZE bytes of MAP's file at OFFSET plus its index, and stopping at
+ * FILE_LEN.  Pages fault in lazily. */
+static bool
+mmap_populate (struct mmap_file *map, bool writable, off_t offset,
+		off_t file_len) {
+	for (size_t i = 0; i < map->page_cnt; i++) {
+		struct file_page *aux = malloc (sizeof *aux);
+		off_t ofs = offset + i * PGSIZE;
+
+		if (aux == NULL)
+			return false;
+		aux->file = map->file;
+		aux->ofs = ofs;
+		aux->read_bytes = ofs < file_len
+			? (file_len - ofs < PGSIZE ? file_len - ofs : PGSIZE) : 0;
+		aux->map = map;
+		if (!vm_alloc_page_with_initializer (VM_FILE,
+					(uint8_t *) map->addr + i * PGSIZE, writable, NULL, aux)) {
+			free (aux);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Removes MAP and every page of it that made it into SPT, writing dirty
+ * pages back. */
+static void
+mmap_remove (struct supplemental_page_table *spt, struct mmap_file *map) {
+	for (size_t i = 0; i < map->page_cnt; i++) {
+		struct page *page =
+			spt_find_page (spt, (uint8_t *) map->addr + i * PGSIZE);
+		if (page != NULL && page_get_type (page) == VM_FILE)
+			spt_remove_page (spt, page);
+	}
+	list_remove (&map->elem);
+	file_close (map->file);
+	free (map);
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct mmap_file *map;
+	size_t page_cnt;
+	off_t file_len;
+	bool locked;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || length == 0
+			|| offset < 0 || pg_ofs (offset) != 0)
+		return NULL;
+	if ((uint64_t) addr + length < (uint64_t) addr
+			|| is_kernel_vaddr ((uint64_t) addr + length - 1))
+		return NULL;
+	/* Keep clear of the area the stack may grow into. */
+	if ((uint64_t) addr + length > USER_STACK - stack_limit)
+		return NULL;
+
+	/* The SPT is shared by the threads of a process, so it is searched
+	 * and changed only under the VM lock. */
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	locked = vm_lock ();
+	for (size_t i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, (uint8_t *) addr + i * PGSIZE) != NULL) {
+			vm_unlock (locked);
+			return NULL;
+		}
+
+	file_len = file_length (file);
+	map = malloc (sizeof *map);
+	if (file_len == 0 || map == NULL) {
+		free (map);
+		vm_unlock (locked);
+		return NULL;
+	}
+	map->addr = addr;
+	map->page_cnt = page_cnt;
+	map->file = file_reopen (file);
+	map->stream.next = NULL;
+	map->stream.window = 0;
+	list_push_back (&spt->mmaps, &map->elem);
+
+	if (map->file == NULL
+			|| !mmap_populate (map, writable, offset, file_len)) {
+		mmap_remove (spt, map);
+		addr = NULL;
+	}
+	vm_unlock (locked);
+	return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	bool locked = vm_lock ();
+	struct mmap_file *map = find_mmap (spt, addr);
+
+	if (map != NULL)
+		mmap_remove (spt, map);
+	vm_unlock (locked);
+}
+
+/* Gives DST, the SPT of a child being forked, its own copy of every region
+ * in SRC.  The child's pages fault in lazily and share the parent's frames
+ * while those stay resident. */
+bool
+file_backed_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct list_elem *e;
+
+	for (e = list_begin (&src->mmaps); e != list_end (&src->mmaps);
+			e = list_next (e)) {
+		struct mmap_file *parent_map = list_entry (e, struct mmap_file, elem);
+		struct mmap_file *map = malloc (sizeof *map);
+
+		if (map == NULL)
+			return false;
+		map->addr = parent_map->addr;
+		map->page_cnt = parent_map->page_cnt;
+		map->file = file_reopen (parent_map->file);
+		map->stream.next = NULL;
+		map->stream.window = 0;
+		list_push_back (&dst->mmaps, &map->elem);
+		if (map->file == NULL)
+			return false;
+
+		for (size_t i = 0; i < map->page_cnt; i++) {
+			void *va = (uint8_t *) map->addr + i * PGSIZE;
+			struct page *page = spt_find_page (src, va);
+			struct file_page *aux;
+
+			if (page == NULL || page_get_type (page) != VM_FILE)
+				continue;
+			aux = malloc (sizeof *aux);
+			if (aux == NULL)
+				return false;
+			*aux = *file_page_of (page);
+			aux->file = map->file;
+			aux->map = map;
+			if (!vm_alloc_page_with_initializer (VM_FILE, va, page->writable,
+						NULL, aux)) {
+				free (aux);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* Closes the files of SPT's regions once their pages are gone. */
+void
+file_backed_kill (struct supplemental_page_table *spt) {
+	while (!list_empty (&spt->mmaps)) {
+		struct mmap_file *map = list_entry (list_pop_front (&spt->mmaps),
+				struct mmap_file, elem);
+		file_close (map->file);
+		free (map);
+	}
 }
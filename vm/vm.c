@@ -1,8 +1,58 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/syscall.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "intrinsic.h"
+
+/* CR0 bit that makes ring 0 honor read-only pages. */
+#define CR0_WP (1UL << 16)
+
+/* Every frame currently backing a user page, in clock order. */
+static struct list frame_table;
+
+/* Next frame the clock algorithm looks at. */
+static struct list_elem *clock_hand;
+
+/* The shared zero page.  An anonymous page that has never been written
+ * maps this frame read-only instead of getting its own, until its first
+ * write (see vm_handle_wp()).  It is never freed.
+ *
+ * Only the read-only mapping keeps writes out of it, so the kernel
+ * must honor read-only pages too (CR0.WP): otherwise a system call
+ * writing into a user buffer that has only been read, such as
+ * read() into untouched BSS, would write through to the zero frame
+ * and change every page mapped to it. */
+static void *zero_kva;
+
+/* Caches of pages and frames. */
+static struct kmem_cache page_cache;
+static struct kmem_cache frame_cache;
+static void frame_ctor (void *);
+
+/* Statistics. */
+static long long fault_cnt;          /* Faults resolved. */
+static long long fault_around_cnt;   /* Resident pages mapped around them. */
+static long long readahead_cnt;      /* Pages read ahead of them. */
+
+/* -hugepages: map large aligned user regions with 2 MB pages? */
+bool vm_huge_pages;
+
+/* Fault around and read ahead after faults?  Cleared by
+ * -no-prefetch, to measure faults without them. */
+bool vm_prefetch = true;
+
+/* Most bytes a user stack may span, counting the guard page at its low
+ * end, which is never mapped.  Set with -stack-limit. */
+size_t stack_limit = STACK_LIMIT_DEFAULT;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -15,7 +65,14 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	list_init (&frame_table);
+	clock_hand = NULL;
+	kmem_cache_init (&page_cache, "page", sizeof (struct page), NULL);
+	kmem_cache_init (&frame_cache, "frame", sizeof (struct frame), frame_ctor);
+	ASSERT (rcr0 () & CR0_WP);
+	zero_kva = palloc_get_page (PAL_ZERO);
+	if (zero_kva == NULL)
+		PANIC ("vm_init: no memory for the zero page");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,8 +92,35 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_claim_page_no_evict (struct page *page);
+static bool do_claim_page (struct page *page, bool may_evict);
+static void vm_fault_around (struct page *page);
+static bool vm_claim_large_page (struct page *page);
+static struct fault_stream *page_stream (struct page *page);
+static struct frame *frame_create (void *kva);
 static struct frame *vm_evict_frame (void);
 
+/* VM work that can reach the file system -- lazy loading, writing back
+ * mapped files, evicting either -- runs under filesys_lock, which also
+ * guards the frame table and the swap table.  A fault raised while a system
+ * call already holds the lock (e.g. read() into a lazily loaded buffer)
+ * simply continues under it.  Returns whether the lock was taken, to be
+ * passed to vm_unlock(). */
+bool
+vm_lock (void) {
+	if (lock_held_by_current_thread (&filesys_lock))
+		return false;
+	lock_acquire (&filesys_lock);
+	return true;
+}
+
+/* Releases the lock taken by vm_lock(), if LOCKED. */
+void
+vm_unlock (bool locked) {
+	if (locked)
+		lock_release (&filesys_lock);
+}
+
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
  * `vm_alloc_page`. */
@@ -46,15 +130,37 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
-
-		/* TODO: Insert the page into the spt. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
+
+		page = kmem_cache_alloc (&page_cache);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, pg_round_down (upage), init, type, aux, initializer);
+		page->writable = writable;
+		page->owner = thread_current ()->proc;
+		page->zero_mapped = false;
+
+		if (!spt_insert_page (spt, page)) {
+			kmem_cache_free (&page_cache, page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
@@ -62,82 +168,465 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page key;
+	struct hash_elem *e;
 
-	return page;
+	key.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &key.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	return hash_insert (&spt->pages, &page->spt_elem) == NULL;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete (&spt->pages, &page->spt_elem);
 	vm_dealloc_page (page);
-	return true;
+}
+
+/* Returns the frame under the clock hand and advances the hand. */
+static struct frame *
+clock_advance (void) {
+	struct frame *frame;
+
+	if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+		clock_hand = list_begin (&frame_table);
+	frame = list_entry (clock_hand, struct frame, elem);
+	clock_hand = list_next (clock_hand);
+	return frame;
+}
+
+/* Returns true if any mapper of FRAME has accessed it since the last call,
+ * clearing the accessed bits on the way. */
+static bool
+frame_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->mappers); e != list_end (&frame->mappers);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+		uint64_t *pml4 = page->owner->pml4;
+
+		if (pml4_is_accessed (pml4, page->va)) {
+			pml4_set_accessed (pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
 }
 
 /* Get the struct frame, that will be evicted. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	/* Second-chance clock: a recently accessed frame loses its accessed bits
+	 * and is passed over once.  Two sweeps are always enough unless every
+	 * frame is pinned. */
+	size_t budget = 2 * list_size (&frame_table) + 1;
 
-	return victim;
+	while (!list_empty (&frame_table) && budget-- > 0) {
+		struct frame *frame = clock_advance ();
+
+		if (!frame->pinned && !frame_test_and_clear_accessed (frame))
+			return frame;
+	}
+	return NULL;
 }
 
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victim = vm_get_victim ();
+	struct list_elem *e;
+
+	if (victim == NULL)
+		return NULL;
+
+	/* Unmap first, so no mapper can dirty the frame while it is written
+	 * out.  pml4_clear_page() keeps the dirty bits for swap_out(). */
+	for (e = list_begin (&victim->mappers); e != list_end (&victim->mappers);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+		pml4_clear_page (page->owner->pml4, page->va);
+	}
+	futex_frame_moved (victim->kva);
+	if (!swap_out (victim->page))
+		return NULL;
+
+	while (!list_empty (&victim->mappers)) {
+		struct page *page = list_entry (list_pop_front (&victim->mappers),
+				struct page, frame_elem);
+		page->frame = NULL;
+	}
+	victim->page = NULL;
+	return victim;
+}
 
-	return NULL;
+/* Constructs a frame in FRAME_CACHE.  A frame is freed only once its
+ * mappers list is empty again. */
+static void
+frame_ctor (void *frame_) {
+	struct frame *frame = frame_;
+
+	list_init (&frame->mappers);
+}
+
+/* Returns a new frame for the user pool page at KVA and adds it to the
+ * frame table, or returns NULL if out of memory. */
+static struct frame *
+frame_create (void *kva) {
+	struct frame *frame = kmem_cache_alloc (&frame_cache);
+
+	if (frame == NULL)
+		return NULL;
+	ASSERT (list_empty (&frame->mappers));
+	frame->kva = kva;
+	frame->page = NULL;
+	frame->pinned = false;
+	list_push_back (&frame_table, &frame->elem);
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.  Unless MAY_EVICT, it returns NULL instead of evicting.*/
 static struct frame *
-vm_get_frame (void) {
+vm_get_frame (bool may_evict) {
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	void *kva = palloc_get_page (PAL_USER);
+
+	if (kva != NULL) {
+		frame = frame_create (kva);
+		if (frame == NULL) {
+			palloc_free_page (kva);
+			return NULL;
+		}
+	} else {
+		frame = may_evict ? vm_evict_frame () : NULL;
+		if (frame == NULL)
+			return NULL;
+	}
+	frame->pinned = false;
 
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
+/* Detaches PAGE from its frame and removes PAGE's mapping.  The frame goes
+ * back to the user pool when its last mapper leaves. */
+void
+vm_frame_unlink (struct page *page) {
+	struct frame *frame = page->frame;
+
+	if (frame == NULL)
+		return;
+
+	pml4_clear_page (page->owner->pml4, page->va);
+	list_remove (&page->frame_elem);
+	page->frame = NULL;
+
+	if (!list_empty (&frame->mappers)) {
+		if (frame->page == page)
+			frame->page = list_entry (list_front (&frame->mappers),
+					struct page, frame_elem);
+		return;
+	}
+
+	struct list_elem *next = list_remove (&frame->elem);
+	if (clock_hand == &frame->elem)
+		clock_hand = next;
+	palloc_free_page (frame->kva);
+	kmem_cache_free (&frame_cache, frame);
+}
+
+/* Returns the lowest address the stack may grow down to. */
+static uint8_t *
+stack_floor (void) {
+	return (uint8_t *) USER_STACK - stack_limit + PGSIZE;
+}
+
+/* Returns true if an access to ADDR, with the user stack pointer at RSP,
+ * should grow the stack: ADDR is within the stack limit, above the guard
+ * page, and no more than a push (8 bytes) below RSP. */
+bool
+vm_is_stack_access (void *addr, void *rsp) {
+	uint8_t *va = addr;
+
+	return va < (uint8_t *) USER_STACK && va >= stack_floor ()
+		&& va >= (uint8_t *) rsp - 8;
+}
+
 /* Growing the stack. */
-static void
-vm_stack_growth (void *addr UNUSED) {
+static bool
+vm_stack_growth (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	uint8_t *fault_page = pg_round_down (addr);
+	uint8_t *floor = stack_floor ();
+	uint8_t *top, *bottom, *va;
+
+	/* Fill in everything between the fault and the existing stack at once:
+	 * a large object gets touched at its low end first and is about to be
+	 * filled upward. */
+	for (top = fault_page; top < (uint8_t *) USER_STACK; top += PGSIZE)
+		if (spt_find_page (spt, top) != NULL)
+			break;
+
+	/* Also claim a few pages beyond the fault, so deep recursion traps once
+	 * per STACK_GROW_PAGES pages instead of once per page.  These are best
+	 * effort; only the pages up from the fault must succeed. */
+	bottom = fault_page - (STACK_GROW_PAGES - 1) * PGSIZE;
+	if (bottom < floor || bottom > fault_page)
+		bottom = floor;
+
+	for (va = top - PGSIZE; va >= bottom; va -= PGSIZE) {
+		struct page *page;
+
+		if (!vm_alloc_page (VM_ANON | VM_STACK, va, true))
+			return va < fault_page;
+		page = spt_find_page (spt, va);
+		if (!vm_do_claim_page (page)) {
+			spt_remove_page (spt, page);
+			return va < fault_page;
+		}
+	}
+	return true;
+}
+
+/* Returns true if PAGE will read as all zeros until written: it is an
+ * anonymous page that has not been brought in yet and has no initializer
+ * of its own. */
+static bool
+page_is_zero_fill (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+}
+
+/* Removes PAGE's mapping of the zero page, if it has one. */
+void
+vm_zero_unmap (struct page *page) {
+	if (page->zero_mapped) {
+		pml4_clear_page (page->owner->pml4, page->va);
+		page->zero_mapped = false;
+	}
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	bool locked, success = false;
+
+	/* The only read-only mapping of a writable page is the zero page: the
+	 * first write gives the page a frame of its own. */
+	locked = vm_lock ();
+	if (page->zero_mapped && page->writable) {
+		success = vm_do_claim_page (page);
+		if (success)
+			fault_cnt++;
+	}
+	vm_unlock (locked);
+	return success;
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct page *page;
+	bool locked, success;
+
+	if (addr == NULL || is_kernel_vaddr (addr))
+		return false;
+
+	/* Other threads of the process may be changing the SPT. */
+	locked = vm_lock ();
+	page = spt_find_page (spt, addr);
+	if (page == NULL) {
+		/* In the kernel, f->rsp is the kernel stack; use the user rsp
+		 * saved on system call entry instead. */
+		void *rsp = user ? (void *) f->rsp : thread_current ()->user_rsp;
+
+		success = not_present && vm_is_stack_access (addr, rsp)
+			&& vm_stack_growth (addr);
+		vm_unlock (locked);
+		return success;
+	}
+	if (!not_present || (write && !page->writable)) {
+		success = !not_present && vm_handle_wp (page);
+		vm_unlock (locked);
+		return success;
+	}
+
+	if (!write && page_is_zero_fill (page)) {
+		/* Reading memory nobody has written: share the zero page. */
+		success = pml4_set_page (page->owner->pml4, page->va, zero_kva, false);
+		page->zero_mapped = success;
+		if (success)
+			fault_cnt++;
+	} else {
+		success = (vm_huge_pages && vm_claim_large_page (page))
+			|| vm_do_claim_page (page);
+		if (success) {
+			fault_cnt++;
+			if (vm_prefetch)
+				vm_fault_around (page);
+		}
+	}
+	vm_unlock (locked);
+	return success;
+}
+
+/* Brings in the whole 2 MB-aligned block around PAGE as one large page, if
+ * every 4 kB page in it belongs to PAGE's region, has the same permissions
+ * and has never been brought in.  Each 4 kB page still gets a frame of its
+ * own, carved out of one aligned 2 MB allocation, so the rest of the VM
+ * is unaware of the large page; the MMU splits it once one of its pages
+ * is unmapped, e.g. by eviction.  Never evicts.  Returns true if PAGE
+ * ended up resident. */
+static bool
+vm_claim_large_page (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct fault_stream *stream = page_stream (page);
+	uint8_t *base = (uint8_t *) ROUND_DOWN ((uint64_t) page->va, LGPGSIZE);
+	uint8_t *kva;
+	bool success = true;
+
+	for (size_t i = 0; i < LGPG_CNT; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		if (p == NULL || p->frame != NULL || p->zero_mapped
+				|| VM_TYPE (p->operations->type) != VM_UNINIT
+				|| p->writable != page->writable || page_stream (p) != stream
+				|| (page_get_type (p) == VM_FILE && file_backed_lookup (p)))
+			return false;
+	}
+
+	kva = palloc_get_multiple_aligned (PAL_USER, LGPG_CNT, LGPG_CNT);
+	if (kva == NULL)
+		return false;
+
+	for (size_t i = 0; i < LGPG_CNT; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = frame_create (kva + i * PGSIZE);
+
+		if (frame == NULL) {
+			palloc_free_multiple (kva + i * PGSIZE, LGPG_CNT - i);
+			success = false;
+			break;
+		}
+		frame->page = p;
+		list_push_back (&frame->mappers, &p->frame_elem);
+		p->frame = frame;
+		if (!swap_in (p, frame->kva)) {
+			vm_frame_unlink (p);
+			success = false;
+		}
+	}
+
+	if (success)
+		success = pml4_set_large_page (page->owner->pml4, base, kva,
+				page->writable);
+	if (!success) {
+		/* Fall back to 4 kB mappings of whatever came in. */
+		for (size_t i = 0; i < LGPG_CNT; i++) {
+			struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+			if (p->frame != NULL && !pml4_set_page (p->owner->pml4, p->va,
+						p->frame->kva, p->writable))
+				vm_frame_unlink (p);
+		}
+	}
+	return page->frame != NULL;
+}
+
+/* Returns the access stream PAGE belongs to: its mapping's for a mapped
+ * file page, the process's for everything else. */
+static struct fault_stream *
+page_stream (struct page *page) {
+	if (page_get_type (page) == VM_FILE)
+		return file_backed_stream (page);
+	return &thread_current ()->proc->spt.stream;
+}
+
+/* Returns true if PAGE is worth bringing in ahead of use: it is not
+ * resident and is still lazy or backed by a file.  Swapped out anonymous
+ * pages are left alone, since swap slots seldom follow address order, and
+ * so are pages only read so far, which are happy with the zero page. */
+static bool
+page_is_prefetchable (struct page *page) {
+	return page->frame == NULL && !page->zero_mapped
+		&& (VM_TYPE (page->operations->type) == VM_UNINIT
+				|| page_get_type (page) == VM_FILE);
+}
+
+/* Called after a fault brought in PAGE, to spare the faults its
+ * neighbours would take.
+ *
+ * Fault-around maps every page in the FAULT_AROUND_PAGES-aligned block
+ * around PAGE whose contents are already resident, i.e. file pages some
+ * other mapping brought in, which costs no I/O.
+ *
+ * Read-ahead follows PAGE's stream: when the fault is on the page a
+ * sequential scan would hit next, the window of pages brought in ahead of
+ * the scan grows, up to READAHEAD_MAX_PAGES; any other fault collapses it.
+ * Neither takes frames by evicting. */
+static void
+vm_fault_around (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct fault_stream *stream = page_stream (page);
+	uint8_t *va = page->va;
+	uint8_t *block = (uint8_t *) ROUND_DOWN ((uint64_t) va,
+			FAULT_AROUND_PAGES * PGSIZE);
+	uint8_t *next;
+
+	for (int i = 0; i < FAULT_AROUND_PAGES; i++) {
+		struct page *p = spt_find_page (spt, block + i * PGSIZE);
+
+		if (p != NULL && p != page && p->frame == NULL
+				&& page_get_type (p) == VM_FILE
+				&& file_backed_lookup (p) != NULL
+				&& vm_claim_page_no_evict (p))
+			fault_around_cnt++;
+	}
+
+	if (va == stream->next)
+		stream->window = stream->window == 0 ? READAHEAD_MIN_PAGES
+			: (stream->window * 2 < READAHEAD_MAX_PAGES
+					? stream->window * 2 : READAHEAD_MAX_PAGES);
+	else
+		stream->window = 0;
+
+	for (next = va + PGSIZE; next < va + (stream->window + 1) * PGSIZE;
+			next += PGSIZE) {
+		struct page *p = spt_find_page (spt, next);
+
+		/* Stay within the region. */
+		if (p == NULL || page_stream (p) != stream)
+			break;
+		if (p->frame != NULL)
+			continue;
+		if (!page_is_prefetchable (p) || !vm_claim_page_no_evict (p))
+			break;
+		readahead_cnt++;
+	}
+	stream->next = next;
+}
 
-	return vm_do_claim_page (page);
+/* Prints VM statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM: %lld faults, %lld pages faulted around, %lld read ahead\n",
+			fault_cnt, fault_around_cnt, readahead_cnt);
 }
 
 /* Free the page.
@@ -150,41 +639,162 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	bool locked = vm_lock ();
+	struct page *page = spt_find_page (&thread_current ()->proc->spt, va);
+	bool success = page != NULL && vm_do_claim_page (page);
+
+	vm_unlock (locked);
+	return success;
+}
 
-	return vm_do_claim_page (page);
+/* Returns the kernel address of user address VA in the current
+ * process, or NULL if VA is not mapped.  A page that has no frame of its
+ * own, because it is not resident or maps the zero page, yields NULL
+ * unless BRING_IN, in which case it gets one.  The caller must hold the
+ * VM lock, and the address is good only as long as it does. */
+void *
+vm_user_kva (const void *va, bool bring_in) {
+	struct page *page = spt_find_page (&thread_current ()->proc->spt,
+			(void *) va);
+
+	if (page == NULL)
+		return NULL;
+	if (page->frame == NULL && (!bring_in || !vm_do_claim_page (page)))
+		return NULL;
+	return (uint8_t *) page->frame->kva + pg_ofs (va);
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return do_claim_page (page, true);
+}
+
+/* Claims PAGE only if that needs no eviction. */
+static bool
+vm_claim_page_no_evict (struct page *page) {
+	return do_claim_page (page, false);
+}
+
+/* Claims PAGE, evicting another page to make room only if MAY_EVICT. */
+static bool
+do_claim_page (struct page *page, bool may_evict) {
+	struct frame *frame = NULL;
+
+	ASSERT (page->frame == NULL);
+
+	/* The mapping set up below replaces any mapping of the zero page. */
+	page->zero_mapped = false;
+
+	/* A file range some other mapping already brought in is shared. */
+	if (page_get_type (page) == VM_FILE)
+		frame = file_backed_lookup (page);
+	if (frame == NULL)
+		frame = vm_get_frame (may_evict);
+	if (frame == NULL)
+		return false;
 
 	/* Set links */
-	frame->page = page;
+	if (frame->page == NULL)
+		frame->page = page;
+	list_push_back (&frame->mappers, &page->frame_elem);
 	page->frame = frame;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	frame->pinned = true;
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)
+			|| !swap_in (page, frame->kva)) {
+		frame->pinned = false;
+		vm_frame_unlink (page);
+		return false;
+	}
+	frame->pinned = false;
+	return true;
+}
+
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *page = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&page->va, sizeof page->va);
+}
 
-	return swap_in (page, frame->kva);
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, spt_elem)->va
+		< hash_entry (b, struct page, spt_elem)->va;
+}
+
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	list_init (&spt->mmaps);
+	spt->stream.next = NULL;
+	spt->stream.window = 0;
+}
+
+/* Gives the current process a private copy of anonymous page SRC, which
+ * belongs to the parent being forked. */
+static bool
+copy_anon_page (struct page *src) {
+	struct page *dst;
+	bool success;
+
+	/* A page that is still all zeros stays lazy in the child too. */
+	if (page_is_zero_fill (src))
+		return vm_alloc_page (src->uninit.type, src->va, src->writable);
+
+	/* Bring SRC in on the parent's behalf if it is still lazy or has been
+	 * swapped out, and keep it in while we copy. */
+	if (src->frame == NULL && !vm_do_claim_page (src))
+		return false;
+	src->frame->pinned = true;
+
+	success = vm_alloc_page (VM_ANON, src->va, src->writable)
+		&& (dst = spt_find_page (&thread_current ()->proc->spt, src->va)) != NULL
+		&& vm_do_claim_page (dst);
+	if (success)
+		memcpy (dst->frame->kva, src->frame->kva, PGSIZE);
+
+	src->frame->pinned = false;
+	return success;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct hash_iterator i;
+	bool locked = vm_lock ();
+	bool success = file_backed_copy (dst, src);
+
+	hash_first (&i, &src->pages);
+	while (success && hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+
+		/* Mapped file pages were handled with their regions. */
+		if (page_get_type (page) != VM_FILE)
+			success = copy_anon_page (page);
+	}
+	vm_unlock (locked);
+	return success;
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	bool locked = vm_lock ();
+
+	/* Destroying a mapped page writes it back if it is dirty; the regions'
+	 * files are closed afterwards. */
+	hash_destroy (&spt->pages, page_destructor);
+	file_backed_kill (spt);
+	vm_unlock (locked);
 }